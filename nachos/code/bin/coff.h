@@ -47,3 +47,52 @@ struct scnhdr {
         long            s_flags;        /* flags */
       };
  
+
+/* The symbolic header, at f_symptr.  We only use the external symbols,
+ * which are enough to name the functions of a program.
+ */
+struct symhdr {
+        short   magic;          /* to verify validity of the table      */
+        short   vstamp;         /* version stamp                        */
+        long    ilineMax;       /* number of line number entries        */
+        long    cbLine;         /* number of bytes for line numbers     */
+        long    cbLineOffset;   /* offset to start of line numbers      */
+        long    idnMax;         /* max index into dense number table    */
+        long    cbDnOffset;     /* offset to start dense number table   */
+        long    ipdMax;         /* number of procedures                 */
+        long    cbPdOffset;     /* offset to procedure descriptors      */
+        long    isymMax;        /* number of local symbols              */
+        long    cbSymOffset;    /* offset to start of local symbols     */
+        long    ioptMax;        /* max index into optimization entries  */
+        long    cbOptOffset;    /* offset to optimization entries       */
+        long    iauxMax;        /* number of auxiliary symbols          */
+        long    cbAuxOffset;    /* offset to start of auxiliary symbols */
+        long    issMax;         /* max index into local strings         */
+        long    cbSsOffset;     /* offset to start of local strings     */
+        long    issExtMax;      /* max index into external strings      */
+        long    cbSsExtOffset;  /* offset to start of external strings  */
+        long    ifdMax;         /* number of file descriptors           */
+        long    cbFdOffset;     /* offset to file descriptors           */
+        long    crfd;           /* number of relative file descriptors  */
+        long    cbRfdOffset;    /* offset to relative file descriptors  */
+        long    iextMax;        /* number of external symbols           */
+        long    cbExtOffset;    /* offset to start of external symbols  */
+      };
+
+#define SYMHMAGIC       0x7009
+
+/* An external symbol */
+struct extsym {
+        unsigned short  es_flags;       /* jmptbl, cobol_main, weakext */
+        short           es_ifd;         /* where the symbol is defined */
+        long            es_iss;         /* index into external strings */
+        long            es_value;       /* value (address, for a proc) */
+        unsigned long   es_type;        /* st:6, sc:5, reserved:1, index:20 */
+      };
+
+#define ES_ST(es)       ((es).es_type & 0x3f)           /* symbol type */
+#define ES_SC(es)       (((es).es_type >> 6) & 0x1f)    /* storage class */
+
+#define stProc          6
+#define stStaticProc    14
+#define scText          1
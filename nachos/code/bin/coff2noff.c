@@ -15,6 +15,10 @@
  *	.data	-- initialized data
  *	.bss/.sbss -- uninitialized data (should be zero'd on program startup)
  *
+ * The NOFF format has no symbols, so the functions' names and addresses
+ * are written to a side file, "<noffFileName>.sym", one "<address> <name>"
+ * line per function; the Nachos profiler uses it to name addresses.
+ *
  * Copyright (c) 1992-1993 The Regents of the University of California.
  * All rights reserved.  See copyright.h for copyright notice and limitation 
  * of liability and disclaimer of warranty provisions.
@@ -90,6 +94,56 @@ void Write(int fd, char *buf, int nBytes)
     }
 }
 
+/* Write the external functions in the COFF symbol table to "<noff>.sym".
+ * This is a convenience, so if anything is missing we just give up.
+ */
+void WriteSymbols(int fdIn, struct filehdr *fileh)
+{
+    struct symhdr symh;
+    struct extsym es;
+    char *strings, symFileName[PATH_MAX];
+    FILE *out;
+    int i;
+
+    if (WordToHost(fileh->f_symptr) == 0)
+	return;				/* stripped */
+    lseek(fdIn, WordToHost(fileh->f_symptr), 0);
+    if ((read(fdIn, (char *)&symh, sizeof(symh)) != sizeof(symh))
+		|| (ShortToHost(symh.magic) != SYMHMAGIC))
+	return;
+    symh.issExtMax = WordToHost(symh.issExtMax);
+    symh.iextMax = WordToHost(symh.iextMax);
+
+    strings = malloc(symh.issExtMax + 1);
+    lseek(fdIn, WordToHost(symh.cbSsExtOffset), 0);
+    if (read(fdIn, strings, symh.issExtMax) != symh.issExtMax) {
+	free(strings);
+	return;
+    }
+    strings[symh.issExtMax] = '\0';
+
+    sprintf(symFileName, "%.*s.sym", PATH_MAX - 5, noffFileName);
+    if ((out = fopen(symFileName, "w")) == NULL) {
+	perror(symFileName);
+	free(strings);
+	return;
+    }
+    lseek(fdIn, WordToHost(symh.cbExtOffset), 0);
+    for (i = 0; i < symh.iextMax; i++) {
+	if (read(fdIn, (char *)&es, sizeof(es)) != sizeof(es))
+	    break;
+	es.es_iss = WordToHost(es.es_iss);
+	es.es_type = WordToHost(es.es_type);
+	if (((ES_ST(es) == stProc) || (ES_ST(es) == stStaticProc))
+		&& (ES_SC(es) == scText)
+		&& (es.es_iss >= 0) && (es.es_iss < symh.issExtMax))
+	    fprintf(out, "%08x %s\n", WordToHost(es.es_value),
+					&strings[es.es_iss]);
+    }
+    fclose(out);
+    free(strings);
+}
+
 main (int argc, char **argv)
 {
     int fdIn, fdOut, numsections, i, inNoffFile;
@@ -222,6 +276,7 @@ main (int argc, char **argv)
     }
     lseek(fdOut, 0, 0);
     Write(fdOut, (char *)&noffH, sizeof(NoffHeader));
+    WriteSymbols(fdIn, &fileh);
     close(fdIn);
     close(fdOut);
     exit(0);
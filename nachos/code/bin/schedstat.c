@@ -0,0 +1,335 @@
+/* schedstat.c
+ *
+ * This program reads a scheduling trace, as written by Nachos with
+ * -trace (see threads/schedtrace.h), and prints, for each process, when
+ * it arrived, its response time (from arriving to first running), its
+ * turnaround time (from arriving to exiting), and the time it spent
+ * waiting on the ready queue and running; then the distribution of each
+ * of these over the processes (and of the individual waits), and a
+ * Gantt chart of what each CPU ran.
+ *
+ * A process arrives when it is first put on the ready queue.  If the
+ * oldest events were overwritten before the trace was written, the
+ * processes that arrived before the first event left in it are not
+ * counted in the response and turnaround times.
+ *
+ * Usage: schedstat [-w <columns>] [-n] <trace file>
+ *
+ *	-w sets the width of the Gantt chart (default 72 columns)
+ *	-n leaves the Gantt chart out
+ *
+ * Copyright (c) 1992-1993 The Regents of the University of California.
+ * All rights reserved.  See copyright.h for copyright notice and limitation
+ * of liability and disclaimer of warranty provisions.
+ */
+
+#define MAIN
+#include "copyright.h"
+#undef MAIN
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "schedtrace.h"
+
+#define None		-1		/* time not seen in the trace */
+
+/* What the trace says about one process */
+typedef struct {
+	int arrival;			/* first put on the ready queue */
+	int firstRun, exit;
+	int readySince;			/* on the ready queue since */
+	int runningSince, cpu;		/* running since, and where */
+	int waitTotal, runTotal;
+	int dispatches, expiries, sleeps;
+} Process;
+
+/* A stretch of time a CPU ran a process, for the Gantt chart */
+typedef struct {
+	int cpu, pid, start, end;
+} Run;
+
+/* A growable array of ints, for the distributions */
+typedef struct {
+	int *values;
+	int count, size;
+} Samples;
+
+Process *procs;
+int numProcs;
+Run *runs;
+int numRuns, runsSize;
+Samples waits;
+
+void
+AddSample(Samples *s, int value)
+{
+	if (s->count == s->size) {
+	    s->size = (s->size > 0) ? 2 * s->size : 256;
+	    s->values = (int *) realloc(s->values, s->size * sizeof(int));
+	}
+	s->values[s->count++] = value;
+}
+
+int
+CompareInts(const void *a, const void *b)
+{
+	return *(const int *) a - *(const int *) b;
+}
+
+/* Print the count, mean, extremes and percentiles of the samples */
+void
+PrintDistribution(char *name, Samples *s)
+{
+	double total = 0;
+	int i;
+
+	if (s->count == 0) {
+	    printf("%-12s %7d\n", name, 0);
+	    return;
+	}
+	qsort(s->values, s->count, sizeof(int), CompareInts);
+	for (i = 0; i < s->count; i++)
+	    total += s->values[i];
+	printf("%-12s %7d %9.1f %8d %8d %8d %8d %8d\n", name, s->count,
+	    total / s->count, s->values[0], s->values[s->count / 2],
+	    s->values[(s->count * 9) / 10], s->values[(s->count * 99) / 100],
+	    s->values[s->count - 1]);
+}
+
+/* Process "pid" stopped running at time "tick" */
+void
+EndRun(int pid, int tick)
+{
+	Process *p = &procs[pid];
+
+	if (p->runningSince == None)
+	    return;
+	p->runTotal += tick - p->runningSince;
+	if (numRuns == runsSize) {
+	    runsSize = (runsSize > 0) ? 2 * runsSize : 256;
+	    runs = (Run *) realloc(runs, runsSize * sizeof(Run));
+	}
+	runs[numRuns].cpu = p->cpu;
+	runs[numRuns].pid = pid;
+	runs[numRuns].start = p->runningSince;
+	runs[numRuns].end = tick;
+	numRuns++;
+	p->runningSince = None;
+}
+
+/* Go through the events, in order */
+void
+Replay(SchedTraceEvent *events, int numEvents)
+{
+	SchedTraceEvent *e;
+	Process *p;
+	int i;
+
+	for (i = 0; i < numEvents; i++) {
+	    e = &events[i];
+	    p = &procs[e->pid];
+	    switch (e->event) {
+	      case TRACE_ARRIVE:
+		p->arrival = e->tick;
+		/* fall through */
+	      case TRACE_READY:
+		EndRun(e->pid, e->tick);
+		p->readySince = e->tick;
+		break;
+	      case TRACE_DISPATCH:
+		if (p->readySince != None) {
+		    p->waitTotal += e->tick - p->readySince;
+		    AddSample(&waits, e->tick - p->readySince);
+		    p->readySince = None;
+		}
+		if (p->firstRun == None)
+		    p->firstRun = e->tick;
+		p->runningSince = e->tick;
+		p->cpu = e->cpu;
+		p->dispatches++;
+		break;
+	      case TRACE_SLEEP:
+		EndRun(e->pid, e->tick);
+		p->sleeps++;
+		break;
+	      case TRACE_EXPIRE:
+		p->expiries++;
+		break;
+	      case TRACE_EXIT:
+		EndRun(e->pid, e->tick);
+		p->exit = e->tick;
+		break;
+	    }
+	}
+	for (i = 0; i < numProcs; i++)		/* still running at the end */
+	    EndRun(i, events[numEvents - 1].tick);
+}
+
+void
+PrintProcesses()
+{
+	Samples response, turnaround, waiting, running;
+	Process *p;
+	int i;
+
+	memset(&response, 0, sizeof(Samples));
+	memset(&turnaround, 0, sizeof(Samples));
+	memset(&waiting, 0, sizeof(Samples));
+	memset(&running, 0, sizeof(Samples));
+	printf("%5s %9s %9s %10s %9s %9s %6s %6s %6s\n", "pid", "arrival",
+	    "response", "turnaround", "wait", "run", "runs", "slices",
+	    "sleeps");
+	for (i = 0; i < numProcs; i++) {
+	    p = &procs[i];
+	    if ((p->dispatches == 0) && (p->arrival == None))
+		continue;			/* not in the trace */
+	    printf("%5d", i);
+	    if (p->arrival != None)
+		printf(" %9d", p->arrival);
+	    else
+		printf(" %9s", "-");
+	    if ((p->arrival != None) && (p->firstRun != None)) {
+		printf(" %9d", p->firstRun - p->arrival);
+		AddSample(&response, p->firstRun - p->arrival);
+	    } else
+		printf(" %9s", "-");
+	    if ((p->arrival != None) && (p->exit != None)) {
+		printf(" %10d", p->exit - p->arrival);
+		AddSample(&turnaround, p->exit - p->arrival);
+	    } else
+		printf(" %10s", "-");
+	    printf(" %9d %9d %6d %6d %6d\n", p->waitTotal, p->runTotal,
+		p->dispatches, p->expiries, p->sleeps);
+	    AddSample(&waiting, p->waitTotal);
+	    AddSample(&running, p->runTotal);
+	}
+
+	printf("\n%-12s %7s %9s %8s %8s %8s %8s %8s\n", "", "count", "mean",
+	    "min", "median", "90%", "99%", "max");
+	PrintDistribution("response", &response);
+	PrintDistribution("turnaround", &turnaround);
+	PrintDistribution("total wait", &waiting);
+	PrintDistribution("each wait", &waits);
+	PrintDistribution("run time", &running);
+}
+
+/* One character for each pid; '.' is an idle CPU */
+char
+PidChar(int pid)
+{
+	static char chars[] = "0123456789abcdefghijklmnopqrstuvwxyz"
+				"ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+
+	return chars[pid % (sizeof(chars) - 1)];
+}
+
+/* Each column shows what ran at the middle of its stretch of time */
+void
+PrintGantt(int numCPUs, int start, int end, int width)
+{
+	char *row = (char *) malloc(width + 1);
+	double perColumn = (double)(end - start) / width;
+	int cpu, i, c, first, last;
+
+	if (end <= start)
+	    return;
+	printf("\nGantt chart, %.1f ticks per column (pid mod 62; "
+	    "'.' idle):\n", perColumn);
+	for (cpu = 0; cpu < numCPUs; cpu++) {
+	    memset(row, '.', width);
+	    row[width] = '\0';
+	    for (i = 0; i < numRuns; i++) {
+		if (runs[i].cpu != cpu)
+		    continue;
+		/* the columns whose middle is in [start, end) */
+		first = (int)((runs[i].start - start) / perColumn + 0.5);
+		last = (int)((runs[i].end - start) / perColumn + 0.5);
+		for (c = first; (c < last) && (c < width); c++)
+		    row[c] = PidChar(runs[i].pid);
+	    }
+	    printf("CPU %-3d |%s|\n", cpu, row);
+	}
+	printf("        %-*d%*d\n", width / 2 + 1, start, width - width / 2 + 1, end);
+	free(row);
+}
+
+void
+Usage()
+{
+	fprintf(stderr, "Usage: schedstat [-w <columns>] [-n] <trace file>\n");
+	exit(1);
+}
+
+int
+main (int argc, char **argv)
+{
+	SchedTraceHeader header;
+	SchedTraceEvent *events;
+	int width = 72, gantt = 1, i;
+	FILE *in;
+
+	for (argc--, argv++; (argc > 1) && (**argv == '-'); argc--, argv++) {
+	    if (!strcmp(*argv, "-w") && (argc > 2)) {
+		width = atoi(*(argv + 1));
+		argc--, argv++;
+	    } else if (!strcmp(*argv, "-n"))
+		gantt = 0;
+	    else
+		Usage();
+	}
+	if ((argc != 1) || (width < 1))
+	    Usage();
+
+	if ((in = fopen(*argv, "r")) == NULL) {
+	    perror(*argv);
+	    exit(1);
+	}
+	if ((fread(&header, sizeof(header), 1, in) != 1)
+				|| (header.magic != SCHED_TRACE_MAGIC)
+				|| (header.numEvents < 0) || (header.numCPUs < 1)) {
+	    fprintf(stderr, "schedstat: %s is not a scheduling trace\n", *argv);
+	    exit(1);
+	}
+	events = (SchedTraceEvent *) malloc((header.numEvents + 1)
+						* sizeof(SchedTraceEvent));
+	if (fread(events, sizeof(SchedTraceEvent), header.numEvents, in)
+					!= (size_t) header.numEvents) {
+	    fprintf(stderr, "schedstat: %s is cut short\n", *argv);
+	    exit(1);
+	}
+	fclose(in);
+	if (header.numEvents == 0) {
+	    printf("No events.\n");
+	    exit(0);
+	}
+
+	for (i = 0; i < header.numEvents; i++) {
+	    if ((events[i].pid < 0) || (events[i].cpu < 0)
+				|| (events[i].cpu >= header.numCPUs)) {
+		fprintf(stderr, "schedstat: %s is corrupt\n", *argv);
+		exit(1);
+	    }
+	    if (events[i].pid >= numProcs)
+		numProcs = events[i].pid + 1;
+	}
+	procs = (Process *) malloc(numProcs * sizeof(Process));
+	for (i = 0; i < numProcs; i++) {
+	    memset(&procs[i], 0, sizeof(Process));
+	    procs[i].arrival = procs[i].firstRun = procs[i].exit = None;
+	    procs[i].readySince = procs[i].runningSince = None;
+	}
+
+	printf("%d events, ticks %d to %d", header.numEvents, events[0].tick,
+	    events[header.numEvents - 1].tick);
+	if (header.numLost > 0)
+	    printf(" (%d earlier events were lost)", header.numLost);
+	printf("\n\n");
+	Replay(events, header.numEvents);
+	PrintProcesses();
+	if (gantt)
+	    PrintGantt(header.numCPUs, events[0].tick,
+			events[header.numEvents - 1].tick, width);
+	exit(0);
+}
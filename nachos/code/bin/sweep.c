@@ -0,0 +1,312 @@
+/* sweep.c
+ *
+ * This program runs a batch script (see test/batch_scripts) under every
+ * combination of a set of scheduling algorithms, page replacement
+ * policies, time slices and memory sizes, and prints the statistics of
+ * all the runs as one table.
+ *
+ * Each run is a separate Nachos process, so the runs don't share any
+ * state; up to one run per host CPU (or as many as -j says) go on at
+ * the same time.  The scheduling algorithm is the first line of the
+ * batch script, so each run gets its own copy of the script, with that
+ * line replaced.
+ *
+ * Usage: sweep [-j <jobs>] [-n <nachos binary>] [-A <algorithms>]
+ *		[-R <policies>] [-q <time slices>] [-M <# of pages>]
+ *		<batch script> ...
+ *
+ * Each list is comma separated, e.g. "-A 1,2,3,4".  A parameter that is
+ * not given keeps its default (for -A, whatever the script says).
+ * Run it from the directory the batch scripts' paths are relative to,
+ * normally userprog:
+ *
+ *	../bin/sweep -A 1,3,4 -q 50,100 ../test/batch_scripts/input1_1.txt
+ *
+ * Copyright (c) 1992-1993 The Regents of the University of California.
+ * All rights reserved.  See copyright.h for copyright notice and limitation
+ * of liability and disclaimer of warranty provisions.
+ */
+
+#define MAIN
+#include "copyright.h"
+#undef MAIN
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MaxValues	32		/* values per parameter */
+#define Default		-1		/* parameter not given */
+
+/* One simulator run, and what it reported */
+typedef struct {
+	char *script;			/* the batch script, as given */
+	int algo, repl, quantum, pages;	/* parameters, or Default */
+	char scriptCopy[32];		/* script with algo filled in */
+	char output[32];		/* where the run's output goes */
+	pid_t pid;
+	int status;			/* as returned by waitpid */
+
+	int ticks, busy, bursts;	/* the run's statistics */
+	int preemptive, nonPreemptive;
+	int waitTotal, faults;
+	float waitAverage;
+} Run;
+
+/* Turn a comma separated list into at most MaxValues integers */
+int
+ParseList(char *list, int *values)
+{
+	int count = 0;
+	char *value;
+
+	for (value = strtok(list, ","); value != NULL;
+						value = strtok(NULL, ",")) {
+	    if (count == MaxValues) {
+		fprintf(stderr, "sweep: too many values in list\n");
+		exit(1);
+	    }
+	    values[count++] = atoi(value);
+	}
+	return count;
+}
+
+/* Copy the batch script, replacing its first line with "algo" */
+void
+CopyScript(Run *run)
+{
+	FILE *in, *out;
+	int c, fd;
+
+	strcpy(run->scriptCopy, "/tmp/sweepXXXXXX");
+	if ((fd = mkstemp(run->scriptCopy)) < 0) {
+	    perror("sweep: mkstemp");
+	    exit(1);
+	}
+	if ((in = fopen(run->script, "r")) == NULL) {
+	    perror(run->script);
+	    exit(1);
+	}
+	out = fdopen(fd, "w");
+	while (((c = getc(in)) != EOF) && (c != '\n'))
+	    ;				/* skip the script's algorithm */
+	fprintf(out, "%d\n", run->algo);
+	while ((c = getc(in)) != EOF)
+	    putc(c, out);
+	fclose(in);
+	fclose(out);
+}
+
+/* Fork off a Nachos process for the run, with its output going to a file */
+void
+StartRun(Run *run, char *nachos)
+{
+	char *argv[16], args[4][16];
+	int argc = 0, fd;
+
+	strcpy(run->output, "/tmp/sweepXXXXXX");
+	if ((fd = mkstemp(run->output)) < 0) {
+	    perror("sweep: mkstemp");
+	    exit(1);
+	}
+
+	argv[argc++] = nachos;
+	if (run->repl != Default) {
+	    sprintf(args[0], "%d", run->repl);
+	    argv[argc++] = "-R";
+	    argv[argc++] = args[0];
+	}
+	if (run->quantum != Default) {
+	    sprintf(args[1], "%d", run->quantum);
+	    argv[argc++] = "-q";
+	    argv[argc++] = args[1];
+	}
+	if (run->pages != Default) {
+	    sprintf(args[2], "%d", run->pages);
+	    argv[argc++] = "-M";
+	    argv[argc++] = args[2];
+	}
+	argv[argc++] = "-F";
+	argv[argc++] = (run->algo != Default) ? run->scriptCopy : run->script;
+	argv[argc] = NULL;
+
+	if ((run->pid = fork()) < 0) {
+	    perror("sweep: fork");
+	    exit(1);
+	}
+	if (run->pid == 0) {
+	    dup2(fd, 1);
+	    dup2(fd, 2);
+	    close(fd);
+	    execv(nachos, argv);
+	    perror(nachos);
+	    _exit(127);
+	}
+	close(fd);
+}
+
+/* Pick the statistics out of the run's output (cf. Statistics::Print) */
+void
+ReadStatistics(Run *run)
+{
+	FILE *in;
+	char line[256];
+
+	run->ticks = run->busy = run->bursts = -1;
+	run->preemptive = run->nonPreemptive = -1;
+	run->waitTotal = run->faults = -1;
+	run->waitAverage = -1;
+	if ((in = fopen(run->output, "r")) == NULL)
+	    return;
+	while (fgets(line, sizeof(line), in) != NULL) {
+	    sscanf(line, "Total simulated ticks: %d", &run->ticks);
+	    sscanf(line, "Total CPU busy time: %d", &run->busy);
+	    sscanf(line, "Non-zero CPU burst statistics: count: %d",
+							&run->bursts);
+	    sscanf(line, "Number of context switches through yield or "
+		"preemption: %d, Number of non-preemptive context switches: %d",
+		&run->preemptive, &run->nonPreemptive);
+	    sscanf(line, "Wait time in ready queue: Total: %d, Average: %f",
+		&run->waitTotal, &run->waitAverage);
+	    sscanf(line, "The total number of page faults is: %d",
+							&run->faults);
+	}
+	fclose(in);
+}
+
+/* Print a parameter, or "-" if it was left at its default */
+void
+PrintParameter(int value, int width)
+{
+	if (value == Default)
+	    printf(" %*s", width, "-");
+	else
+	    printf(" %*d", width, value);
+}
+
+void
+PrintTable(Run *runs, int numRuns)
+{
+	int i;
+	Run *run;
+
+	printf("%-36s %4s %4s %5s %5s %10s %6s %9s %7s %7s %7s  %s\n",
+	    "script", "algo", "repl", "slice", "pages", "ticks", "util%",
+	    "wait avg", "preempt", "switch", "faults", "status");
+	for (i = 0; i < numRuns; i++) {
+	    run = &runs[i];
+	    printf("%-36s", run->script);
+	    PrintParameter(run->algo, 4);
+	    PrintParameter(run->repl, 4);
+	    PrintParameter(run->quantum, 5);
+	    PrintParameter(run->pages, 5);
+	    printf(" %10d %6.2f %9.2f %7d %7d %7d  ", run->ticks,
+		(run->ticks > 0) ? 100.0 * run->busy / run->ticks : 0.0,
+		run->waitAverage, run->preemptive, run->nonPreemptive,
+		run->faults);
+	    if (WIFEXITED(run->status) && (WEXITSTATUS(run->status) == 0))
+		printf("ok\n");
+	    else if (WIFEXITED(run->status))
+		printf("exit %d (%s)\n", WEXITSTATUS(run->status), run->output);
+	    else
+		printf("signal %d (%s)\n", WTERMSIG(run->status), run->output);
+	}
+}
+
+void
+Usage()
+{
+	fprintf(stderr, "Usage: sweep [-j <jobs>] [-n <nachos binary>] "
+	    "[-A <algorithms>] [-R <policies>]\n"
+	    "\t[-q <time slices>] [-M <# of pages>] <batch script> ...\n");
+	exit(1);
+}
+
+int
+main (int argc, char **argv)
+{
+	int algos[MaxValues], repls[MaxValues];
+	int quanta[MaxValues], pages[MaxValues];
+	int numAlgos = 1, numRepls = 1, numQuanta = 1, numPages = 1;
+	int jobs, running, numRuns, next, i, a, r, q, m, s, status;
+	char *nachos = "./nachos";
+	Run *runs;
+	pid_t pid;
+
+	algos[0] = repls[0] = quanta[0] = pages[0] = Default;
+	jobs = sysconf(_SC_NPROCESSORS_ONLN);
+	for (argc--, argv++; (argc > 1) && (**argv == '-');
+						argc -= 2, argv += 2) {
+	    if (!strcmp(*argv, "-j"))
+		jobs = atoi(*(argv + 1));
+	    else if (!strcmp(*argv, "-n"))
+		nachos = *(argv + 1);
+	    else if (!strcmp(*argv, "-A"))
+		numAlgos = ParseList(*(argv + 1), algos);
+	    else if (!strcmp(*argv, "-R"))
+		numRepls = ParseList(*(argv + 1), repls);
+	    else if (!strcmp(*argv, "-q"))
+		numQuanta = ParseList(*(argv + 1), quanta);
+	    else if (!strcmp(*argv, "-M"))
+		numPages = ParseList(*(argv + 1), pages);
+	    else
+		Usage();
+	}
+	if ((argc == 0) || (numAlgos == 0) || (numRepls == 0)
+				|| (numQuanta == 0) || (numPages == 0))
+	    Usage();
+	if (jobs < 1)
+	    jobs = 1;
+
+	numRuns = argc * numAlgos * numRepls * numQuanta * numPages;
+	runs = (Run *) calloc(numRuns, sizeof(Run));
+	i = 0;
+	for (s = 0; s < argc; s++)
+	  for (a = 0; a < numAlgos; a++)
+	    for (r = 0; r < numRepls; r++)
+	      for (q = 0; q < numQuanta; q++)
+		for (m = 0; m < numPages; m++) {
+		    runs[i].script = argv[s];
+		    runs[i].algo = algos[a];
+		    runs[i].repl = repls[r];
+		    runs[i].quantum = quanta[q];
+		    runs[i].pages = pages[m];
+		    if (runs[i].algo != Default)
+			CopyScript(&runs[i]);
+		    i++;
+		}
+
+	/* Keep "jobs" runs going until they are all done */
+	running = next = 0;
+	while ((next < numRuns) || (running > 0)) {
+	    if ((next < numRuns) && (running < jobs)) {
+		StartRun(&runs[next++], nachos);
+		running++;
+		continue;
+	    }
+	    if ((pid = wait(&status)) < 0) {
+		perror("sweep: wait");
+		exit(1);
+	    }
+	    for (i = 0; i < next; i++)
+		if (runs[i].pid == pid) {
+		    runs[i].status = status;
+		    running--;
+		    break;
+		}
+	}
+
+	for (i = 0; i < numRuns; i++) {
+	    ReadStatistics(&runs[i]);
+	    if (runs[i].algo != Default)
+		unlink(runs[i].scriptCopy);
+	    if (WIFEXITED(runs[i].status) && (WEXITSTATUS(runs[i].status) == 0))
+		unlink(runs[i].output);	/* keep the output of failed runs */
+	}
+	PrintTable(runs, numRuns);
+	exit(0);
+}
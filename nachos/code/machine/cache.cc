@@ -0,0 +1,143 @@
+// cache.cc
+//	Routines to model a set associative cache.
+//
+//	A physical address is in line (physAddr / lineSize), which can be
+//	held in any of the "ways" lines of set (line % numSets).  Each line
+//	remembers the full line number, so no tag arithmetic is needed.
+//
+//  DO NOT CHANGE -- part of the machine emulation
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "cache.h"
+#include "machine.h"
+#include "system.h"
+
+//----------------------------------------------------------------------
+// Cache::Cache
+// 	Initialize an empty cache.
+//
+//	"debugName" -- what to call it in reports
+//	"numSets" -- the number of sets
+//	"ways" -- the number of lines in each set
+//	"lineSize" -- the size of a line, in bytes (a power of two that
+//		divides the page size)
+//	"policy" -- which line of a full set to replace
+//----------------------------------------------------------------------
+
+Cache::Cache(char *debugName, int sets, int numWays, int size, int which)
+{
+    int i;
+
+    ASSERT((sets > 0) && (numWays > 0) && (size > 0));
+    ASSERT(((size & (size - 1)) == 0) && ((PageSize % size) == 0));
+    ASSERT((which >= CACHE_FIFO) && (which <= CACHE_LRU));
+    name = debugName;
+    numSets = sets;
+    ways = numWays;
+    lineSize = size;
+    policy = which;
+    tags = new int[numSets * ways];
+    stamps = new unsigned[numSets * ways];
+    for (i = 0; i < numSets * ways; i++) {
+	tags[i] = -1;
+	stamps[i] = 0;
+    }
+    clock = 0;
+    hits = new int[MAX_THREAD_COUNT];
+    misses = new int[MAX_THREAD_COUNT];
+    for (i = 0; i < MAX_THREAD_COUNT; i++)
+	hits[i] = misses[i] = 0;
+}
+
+Cache::~Cache()
+{
+    delete [] tags;
+    delete [] stamps;
+    delete [] hits;
+    delete [] misses;
+}
+
+//----------------------------------------------------------------------
+// Cache::Access
+// 	Look up physical address "physAddr", for process "pid".  On a
+//	miss, the line is brought in, in place of an empty line of its
+//	set if there is one, or else of the one the policy picks.
+//	Returns TRUE on a hit.
+//----------------------------------------------------------------------
+
+bool
+Cache::Access(int physAddr, int pid)
+{
+    int line = physAddr / lineSize;
+    int first = (line % numSets) * ways;
+    int i, victim;
+
+    clock++;
+    for (i = first; i < first + ways; i++)
+	if (tags[i] == line) {
+	    if (policy == CACHE_LRU)
+		stamps[i] = clock;
+	    hits[pid]++;
+	    return TRUE;
+	}
+
+    misses[pid]++;
+    victim = -1;
+    for (i = first; i < first + ways; i++)
+	if (tags[i] == -1) {
+	    victim = i;
+	    break;
+	}
+    if (victim == -1) {			// set is full, replace someone
+	if (policy == CACHE_RANDOM)
+	    victim = first + Random() % ways;
+	else {
+	    victim = first;
+	    for (i = first + 1; i < first + ways; i++)
+		if (stamps[i] < stamps[victim])
+		    victim = i;
+	}
+    }
+    tags[victim] = line;
+    stamps[victim] = clock;
+    return FALSE;
+}
+
+//----------------------------------------------------------------------
+// Cache::InvalidatePage
+// 	Throw away the lines holding any part of physical page "physPage",
+//	whose contents have been replaced.
+//----------------------------------------------------------------------
+
+void
+Cache::InvalidatePage(int physPage)
+{
+    int firstLine = physPage * (PageSize / lineSize);
+    int line, first, i;
+
+    for (line = firstLine; line < firstLine + PageSize / lineSize; line++) {
+	first = (line % numSets) * ways;
+	for (i = first; i < first + ways; i++)
+	    if (tags[i] == line)
+		tags[i] = -1;
+    }
+}
+
+//----------------------------------------------------------------------
+// Cache::Report
+// 	Print the hits and misses of process "pid", if it used the cache.
+//----------------------------------------------------------------------
+
+void
+Cache::Report(int pid)
+{
+    int total = hits[pid] + misses[pid];
+
+    if (total > 0)
+	printf("[pid %d]: %s: hits %d, misses %d, hit ratio %.2f%%\n", pid,
+	    name, hits[pid], misses[pid], 100.0 * hits[pid] / total);
+}
@@ -0,0 +1,60 @@
+// cache.h
+//	Data structures to model a set associative cache, such as the L1
+//	instruction and data caches between the simulated CPU and main
+//	memory.
+//
+//	Only the tags are modelled, not the data: main memory always has
+//	the right contents, and the cache only tells whether an access
+//	would have hit.  Lines are looked up by physical address, so the
+//	cache is shared by all the processes, and needs no flushing on a
+//	context switch; the kernel invalidates a page's lines whenever it
+//	replaces the page's contents (see Machine::InvalidateDecodedPage).
+//
+//	Hits and misses are counted for each process.
+//
+//  DO NOT CHANGE -- part of the machine emulation
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "copyright.h"
+#include "utility.h"
+
+// Replacement policies (numbered as for the TLB, see -tlbrepl)
+#define CACHE_FIFO		0
+#define CACHE_RANDOM		1
+#define CACHE_LRU		2
+
+// The following class defines a cache of "numSets" sets of "ways" lines,
+// each "lineSize" bytes long.
+class Cache {
+  public:
+    Cache(char *debugName, int numSets, int ways, int lineSize, int policy);
+				// Initialize an empty cache
+    ~Cache();
+
+    bool Access(int physAddr, int pid);
+				// Look up an address for process "pid",
+				// bringing its line in on a miss.
+				// Returns TRUE if it was a hit.
+    void InvalidatePage(int physPage);
+				// Throw away the lines of a physical page
+
+    void Report(int pid);	// Print the hits and misses of "pid"
+
+  private:
+    char *name;			// for reports
+    int numSets, ways, lineSize, policy;
+    int *tags;			// line number held by each line, -1 if
+				// none; numSets sets of "ways" lines
+    unsigned *stamps;		// when each line was last used (LRU) or
+				// filled (FIFO)
+    unsigned clock;		// counts accesses, to make the stamps
+    int *hits, *misses;		// by process
+};
+
+#endif // CACHE_H
@@ -23,6 +23,9 @@
 #include "copyright.h"
 #include "interrupt.h"
 #include "system.h"
+#ifdef USER_PROGRAM
+#include "checkpoint.h"
+#endif
 
 // String definitions for debugging messages
 
@@ -48,6 +51,205 @@ PendingInterrupt::PendingInterrupt(VoidFunctionPtr func, int param, int time,
     arg = param;
     when = time;
     type = kind;
+    order = 0;
+    index = -1;
+    next = NULL;
+}
+
+//----------------------------------------------------------------------
+// PendingQueue::PendingQueue
+// 	Initialize an empty queue of pending interrupts, with an empty pool.
+//----------------------------------------------------------------------
+
+PendingQueue::PendingQueue()
+{
+    size = 16;
+    heap = new PendingInterrupt*[size];
+    numPending = 0;
+    nextOrder = 0;
+    freeList = NULL;
+}
+
+//----------------------------------------------------------------------
+// PendingQueue::~PendingQueue
+// 	De-allocate the queue, the interrupts still in it, and the pool.
+//----------------------------------------------------------------------
+
+PendingQueue::~PendingQueue()
+{
+    PendingInterrupt *item;
+
+    for (int i = 0; i < numPending; i++)
+	delete heap[i];
+    while ((item = freeList) != NULL) {
+	freeList = item->next;
+	delete item;
+    }
+    delete [] heap;
+}
+
+//----------------------------------------------------------------------
+// PendingQueue::Allocate
+// 	Return a PendingInterrupt set up with these arguments (see the
+//	PendingInterrupt constructor), reusing one from the pool if there
+//	is one.
+//----------------------------------------------------------------------
+
+PendingInterrupt *
+PendingQueue::Allocate(VoidFunctionPtr func, int param, int time, IntType kind)
+{
+    PendingInterrupt *item = freeList;
+
+    if (item == NULL)
+	return new PendingInterrupt(func, param, time, kind);
+    freeList = item->next;
+    item->handler = func;
+    item->arg = param;
+    item->when = time;
+    item->type = kind;
+    item->index = -1;
+    item->next = NULL;
+    return item;
+}
+
+//----------------------------------------------------------------------
+// PendingQueue::Free
+// 	Put a PendingInterrupt that is no longer queued back in the pool.
+//----------------------------------------------------------------------
+
+void
+PendingQueue::Free(PendingInterrupt *item)
+{
+    ASSERT(item->index == -1);
+    item->next = freeList;
+    freeList = item;
+}
+
+//----------------------------------------------------------------------
+// PendingQueue::Place, PendingQueue::SiftUp, PendingQueue::SiftDown
+// 	Keep the heap in order: move the element at heap[i] up towards
+//	the root, or down towards the leaves, until it is after its parent
+//	and before its children.
+//----------------------------------------------------------------------
+
+void
+PendingQueue::Place(PendingInterrupt *item, int i)
+{
+    heap[i] = item;
+    item->index = i;
+}
+
+void
+PendingQueue::SiftUp(int i)
+{
+    PendingInterrupt *item = heap[i];
+    int parent;
+
+    while (i > 0) {
+	parent = (i - 1) / 2;
+	if (!Before(item, heap[parent]))
+	    break;
+	Place(heap[parent], i);
+	i = parent;
+    }
+    Place(item, i);
+}
+
+void
+PendingQueue::SiftDown(int i)
+{
+    PendingInterrupt *item = heap[i];
+    int child;
+
+    while ((child = 2 * i + 1) < numPending) {
+	if ((child + 1 < numPending) && Before(heap[child + 1], heap[child]))
+	    child++;			// the earlier of the two children
+	if (!Before(heap[child], item))
+	    break;
+	Place(heap[child], i);
+	i = child;
+    }
+    Place(item, i);
+}
+
+//----------------------------------------------------------------------
+// PendingQueue::Insert
+// 	Queue "item", behind any others due at the same time.
+//----------------------------------------------------------------------
+
+void
+PendingQueue::Insert(PendingInterrupt *item)
+{
+    PendingInterrupt **bigger;
+
+    if (numPending == size) {		// out of room, double the heap
+	bigger = new PendingInterrupt*[2 * size];
+	for (int i = 0; i < numPending; i++)
+	    bigger[i] = heap[i];
+	delete [] heap;
+	heap = bigger;
+	size *= 2;
+    }
+    item->order = nextOrder++;
+    Place(item, numPending++);
+    SiftUp(item->index);
+}
+
+//----------------------------------------------------------------------
+// PendingQueue::Remove
+// 	Take "item" out of the queue, wherever it is.
+//----------------------------------------------------------------------
+
+void
+PendingQueue::Remove(PendingInterrupt *item)
+{
+    int i = item->index;
+
+    ASSERT((i >= 0) && (i < numPending) && (heap[i] == item));
+    item->index = -1;
+    if (i == --numPending)		// it was the last one
+	return;
+    Place(heap[numPending], i);		// move the last one into its place
+    SiftUp(i);
+    SiftDown(heap[i]->index);
+}
+
+//----------------------------------------------------------------------
+// PendingQueue::Requeue
+// 	Move "item" behind any others due at the same time, as taking it
+//	off a sorted list and putting it back would.  Its order can only 
+//	go up, so it can only move down the heap.
+//----------------------------------------------------------------------
+
+void
+PendingQueue::Requeue(PendingInterrupt *item)
+{
+    ASSERT((item->index >= 0) && (heap[item->index] == item));
+    item->order = nextOrder++;
+    SiftDown(item->index);
+}
+
+//----------------------------------------------------------------------
+// PendingQueue::FrontCount
+// 	Return how many interrupts are due at the same time as the first
+//	one (0 if there are none).  Only the subtrees holding them are
+//	searched.
+//----------------------------------------------------------------------
+
+int
+PendingQueue::FrontCount()
+{
+    if (numPending == 0)
+	return 0;
+    return CountTies(0, heap[0]->when);
+}
+
+int
+PendingQueue::CountTies(int i, int when)
+{
+    if ((i >= numPending) || (heap[i]->when != when))
+	return 0;
+    return 1 + CountTies(2 * i + 1, when) + CountTies(2 * i + 2, when);
 }
 
 //----------------------------------------------------------------------
@@ -60,10 +262,12 @@ PendingInterrupt::PendingInterrupt(VoidFunctionPtr func, int param, int time,
 Interrupt::Interrupt()
 {
     level = IntOff;
-    pending = new List();
+    pending = new PendingQueue();
     inHandler = FALSE;
     yieldOnReturn = FALSE;
+    checkpointOnReturn = FALSE;
     status = SystemMode;
+    skipping = FALSE;
 }
 
 //----------------------------------------------------------------------
@@ -73,8 +277,6 @@ Interrupt::Interrupt()
 
 Interrupt::~Interrupt()
 {
-    while (!pending->IsEmpty())
-	delete pending->Remove();
     delete pending;
 }
 
@@ -152,6 +354,8 @@ Interrupt::OneTick()
 {
     MachineStatus old = status;
 
+    CatchUp();
+
 // advance simulated time
     if (status == SystemMode) {
         stats->totalTicks += SystemTick;
@@ -169,6 +373,14 @@ Interrupt::OneTick()
     while (CheckIfDue(FALSE))		// check for pending interrupts
 	;
     ChangeLevel(IntOff, IntOn);		// re-enable interrupts
+#ifdef USER_PROGRAM
+    if (checkpointOnReturn && (old == UserMode)) {
+	checkpointOnReturn = FALSE;	// the timer asks again if it fails
+	status = SystemMode;
+	(void) TakeCheckpoint();
+	status = old;
+    }
+#endif
     if (yieldOnReturn) {		// if the timer device handler asked 
 					// for a context switch, ok to do it now
 	yieldOnReturn = FALSE;
@@ -178,6 +390,54 @@ Interrupt::OneTick()
     }
 }
 
+//----------------------------------------------------------------------
+// Interrupt::Horizon
+// 	Return the time at which the next pending interrupt is due
+//	(a very large time if there is none), so that the simulator can
+//	run user instructions until then, advancing stats->totalTicks
+//	and stats->userTicks by UserTick for each, without calling
+//	OneTick.  The first call to OneTick, CheckIfDue or Schedule after
+//	that (at the horizon, or on a trap) catches up with the skipped
+//	ticks.
+//----------------------------------------------------------------------
+
+int
+Interrupt::Horizon()
+{
+    CatchUp();
+    skipping = TRUE;
+    skipFrom = stats->totalTicks;
+    if (pending->IsEmpty())
+	return 0x7fffffff;
+    return pending->Front()->when;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::CatchUp
+// 	Account for the ticks that were skipped since Horizon was called.
+//	Nothing was due during them, so the only thing OneTick would have
+//	done is to have CheckIfDue requeue the first pending interrupt,
+//	behind any others due at the same time.  Do that the same number
+//	of times, so that interrupts due at the same time still fire in
+//	the same order.
+//----------------------------------------------------------------------
+
+void
+Interrupt::CatchUp()
+{
+    int ties, turns;
+
+    if (!skipping)
+	return;
+    skipping = FALSE;
+    ties = pending->FrontCount();
+    if (ties < 2)
+	return;
+    for (turns = ((stats->totalTicks - skipFrom) / UserTick) % ties; 
+						turns > 0; turns--)
+	pending->Requeue(pending->Front());
+}
+
 //----------------------------------------------------------------------
 // Interrupt::YieldOnReturn
 // 	Called from within an interrupt handler, to cause a context switch
@@ -196,6 +456,88 @@ Interrupt::YieldOnReturn()
     yieldOnReturn = TRUE; 
 }
 
+//----------------------------------------------------------------------
+// Interrupt::YieldSoon
+// 	Like YieldOnReturn, but also callable from kernel code outside an
+//	interrupt handler (with interrupts disabled): the current thread
+//	yields at the next tick, once interrupts are re-enabled.  Used to
+//	preempt the running thread when a more urgent one becomes ready.
+//----------------------------------------------------------------------
+
+void
+Interrupt::YieldSoon()
+{ 
+    ASSERT(level == IntOff);
+    yieldOnReturn = TRUE; 
+}
+
+//----------------------------------------------------------------------
+// Interrupt::CheckpointOnReturn
+// 	Called from within an interrupt handler, to take a checkpoint
+//	when the handler returns, provided the interrupted thread was
+//	running user code (so that its state is all in the registers).
+//	Otherwise, nothing happens.
+//----------------------------------------------------------------------
+
+void
+Interrupt::CheckpointOnReturn()
+{ 
+    ASSERT(inHandler == TRUE);  
+    checkpointOnReturn = TRUE; 
+}
+
+//----------------------------------------------------------------------
+// Interrupt::NextTimerInterrupt
+// 	Set "*when" to the time the timer interrupt is due.  Returns
+//	FALSE if a device is in the middle of an operation (some other 
+//	interrupt is pending), since we can't save that in a checkpoint.
+//	The console's polls for input don't count: a new console starts
+//	polling again.
+//----------------------------------------------------------------------
+
+bool
+Interrupt::NextTimerInterrupt(int *when)
+{
+    PendingInterrupt *toOccur;
+    bool onlyTimer = TRUE;
+
+    CatchUp();
+    *when = -1;
+    for (int i = 0; i < pending->NumPending(); i++) {
+	toOccur = pending->Item(i);
+	if (toOccur->type == TimerInt)
+	    *when = toOccur->when;
+	else if (toOccur->type != ConsoleReadInt)
+	    onlyTimer = FALSE;
+    }
+    return onlyTimer && (*when != -1);
+}
+
+//----------------------------------------------------------------------
+// Interrupt::MoveTimerInterrupt
+// 	Make the pending timer interrupt due at "when", and drop any other
+//	pending interrupts.  Used to carry on from a checkpoint, where
+//	only the timer was running (and the console polling for input).
+//----------------------------------------------------------------------
+
+void
+Interrupt::MoveTimerInterrupt(int when)
+{
+    PendingInterrupt *toOccur, *timerInt = NULL;
+
+    CatchUp();
+    while ((toOccur = pending->Front()) != NULL) {
+	pending->Remove(toOccur);
+	if (toOccur->type == TimerInt)
+	    timerInt = toOccur;
+	else
+	    pending->Free(toOccur);
+    }
+    ASSERT(timerInt != NULL);
+    timerInt->when = when;
+    pending->Insert(timerInt);
+}
+
 //----------------------------------------------------------------------
 // Interrupt::Idle
 // 	Routine called when there is nothing in the ready queue.
@@ -247,7 +589,7 @@ Interrupt::Halt()
     printf("Machine halting!\n\n");
     stats->Print();
 
-    if (schedulingAlgo == NON_PREEMPTIVE_SJF) {
+    if ((schedulingAlgo == NON_PREEMPTIVE_SJF) || (schedulingAlgo == SRTF_SCHED)) {
        printf("Error in burst estimate over average burst length: %.2f\n", ((float)stats->burstEstimateError)/stats->cpu_time);
     }
 
@@ -300,7 +642,7 @@ Interrupt::Halt()
 // 	Arrange for the CPU to be interrupted when simulated time
 //	reaches "now + when".
 //
-//	Implementation: just put it on a sorted list.
+//	Implementation: put it in the heap of pending interrupts.
 //
 //	NOTE: the Nachos kernel should not call this routine directly.
 //	Instead, it is only called by the hardware device simulators.
@@ -315,13 +657,39 @@ void
 Interrupt::Schedule(VoidFunctionPtr handler, int arg, int fromNow, IntType type)
 {
     int when = stats->totalTicks + fromNow;
-    PendingInterrupt *toOccur = new PendingInterrupt(handler, arg, when, type);
+    PendingInterrupt *toOccur = pending->Allocate(handler, arg, when, type);
 
     DEBUG('i', "Scheduling interrupt handler the %s at time = %d\n", 
 					intTypeNames[type], when);
     ASSERT(fromNow > 0);
 
-    pending->SortedInsert(toOccur, when);
+    CatchUp();
+    pending->Insert(toOccur);
+}
+
+//----------------------------------------------------------------------
+// Interrupt::Unschedule
+// 	Cancel the pending interrupt that would call "handler" with "arg",
+//	if there is one.  Used by the timer, when the kernel moves its next
+//	interrupt.
+//----------------------------------------------------------------------
+
+void
+Interrupt::Unschedule(VoidFunctionPtr handler, int arg)
+{
+    PendingInterrupt *toOccur;
+
+    CatchUp();
+    for (int i = 0; i < pending->NumPending(); i++) {
+	toOccur = pending->Item(i);
+	if ((toOccur->handler == handler) && (toOccur->arg == arg)) {
+	    DEBUG('i', "Unscheduling interrupt handler the %s at time = %d\n",
+				intTypeNames[toOccur->type], toOccur->when);
+	    pending->Remove(toOccur);
+	    pending->Free(toOccur);
+	    return;
+	}
+    }
 }
 
 //----------------------------------------------------------------------
@@ -345,28 +713,31 @@ Interrupt::CheckIfDue(bool advanceClock)
 
     ASSERT(level == IntOff);		// interrupts need to be disabled,
 					// to invoke an interrupt handler
+    CatchUp();
     if (DebugIsEnabled('i'))
 	DumpState();
-    PendingInterrupt *toOccur = 
-		(PendingInterrupt *)pending->SortedRemove(&when);
+    PendingInterrupt *toOccur = pending->Front();
 
     if (toOccur == NULL)		// no pending interrupts
 	return FALSE;			
 
+    when = toOccur->when;
     if (advanceClock && when > stats->totalTicks) {	// advance the clock
 	stats->idleTicks += (when - stats->totalTicks);
 	stats->totalTicks = when;
     } else if (when > stats->totalTicks) {	// not time yet, put it back
-	pending->SortedInsert(toOccur, when);
+	pending->Requeue(toOccur);		// (behind any ties)
 	return FALSE;
     }
 
-// Check if there is nothing more to do, and if so, quit
+// Check if there is nothing more to do, and if so, quit (a one-shot
+// timer is only pending if the kernel has something to do then)
     if ((status == IdleMode) && (toOccur->type == TimerInt) 
-				&& pending->IsEmpty()) {
-	 pending->SortedInsert(toOccur, when);
+		&& (pending->NumPending() == 1) && timer->IsPeriodic()) {
+	 pending->Requeue(toOccur);
 	 return FALSE;
     }
+    pending->Remove(toOccur);
 
     DEBUG('i', "Invoking interrupt handler for the %s at time %d\n", 
 			intTypeNames[toOccur->type], toOccur->when);
@@ -381,7 +752,7 @@ Interrupt::CheckIfDue(bool advanceClock)
     (*(toOccur->handler))(toOccur->arg);	// call the interrupt handler
     status = old;				// restore the machine status
     inHandler = FALSE;
-    delete toOccur;
+    pending->Free(toOccur);
     return TRUE;
 }
 
@@ -392,10 +763,8 @@ Interrupt::CheckIfDue(bool advanceClock)
 //----------------------------------------------------------------------
 
 static void
-PrintPending(int arg)
+PrintPending(PendingInterrupt *pend)
 {
-    PendingInterrupt *pend = (PendingInterrupt *)arg;
-
     printf("Interrupt handler %s, scheduled at %d\n", 
 	intTypeNames[pend->type], pend->when);
 }
@@ -403,17 +772,32 @@ PrintPending(int arg)
 //----------------------------------------------------------------------
 // DumpState
 // 	Print the complete interrupt state - the status, and all interrupts
-//	that are scheduled to occur in the future.
+//	that are scheduled to occur in the future, in the order they will
+//	occur.
 //----------------------------------------------------------------------
 
 void
 Interrupt::DumpState()
 {
+    int i, j, count = pending->NumPending();
+    PendingInterrupt **sorted = new PendingInterrupt*[count + 1], *item;
+
+    CatchUp();
     printf("Time: %d, interrupts %s\n", stats->totalTicks, 
 					intLevelNames[level]);
     printf("Pending interrupts:\n");
     fflush(stdout);
-    pending->Mapcar(PrintPending);
+    for (i = 0; i < count; i++) {	// insertion sort, there are few
+	item = pending->Item(i);
+	for (j = i; (j > 0) && ((sorted[j - 1]->when > item->when) 
+				|| ((sorted[j - 1]->when == item->when)
+				    && (sorted[j - 1]->order > item->order))); j--)
+	    sorted[j] = sorted[j - 1];
+	sorted[j] = item;
+    }
+    for (i = 0; i < count; i++)
+	PrintPending(sorted[i]);
+    delete [] sorted;
     printf("End of pending interrupts\n");
     fflush(stdout);
 }
@@ -67,6 +67,62 @@ class PendingInterrupt {
     int arg;                    // The argument to the function.
     int when;			// When the interrupt is supposed to fire
     IntType type;		// for debugging
+
+    unsigned order;		// Breaks ties between interrupts due at
+				// the same time: the earliest queued first
+    int index;			// Where it is in the PendingQueue heap
+    PendingInterrupt *next;	// Next free one, when not in use
+};
+
+// The following class defines the queue of pending interrupts, a binary
+// heap ordered by the time each is due, and then by the order they were
+// queued in, so that interrupts due at the same time come out in the
+// same order as from a sorted list.  The first one is found in constant
+// time, and insertion and removal take O(log n) time.  The elements are
+// pooled: they are never deleted, but kept for the next Schedule.
+
+class PendingQueue {
+  public:
+    PendingQueue();			// an empty queue
+    ~PendingQueue();			// delete the queue, and the pool
+
+    PendingInterrupt *Allocate(VoidFunctionPtr func, int param, int time,
+				IntType kind);
+					// get a PendingInterrupt, from the
+					// pool if possible
+    void Free(PendingInterrupt *item);	// return it to the pool
+
+    bool IsEmpty() { return (numPending == 0); }
+    int NumPending() { return numPending; }
+    PendingInterrupt *Front() 		// the next one due (NULL if none)
+	{ return (numPending > 0) ? heap[0] : NULL; }
+    PendingInterrupt *Item(int i) { return heap[i]; }
+					// all of them, in no particular order
+    int FrontCount();			// how many are due at the same time
+					// as the first
+
+    void Insert(PendingInterrupt *item);// queue it, behind any others due
+					// at the same time
+    void Remove(PendingInterrupt *item);// take it out of the queue
+    void Requeue(PendingInterrupt *item);
+					// Remove and Insert again (behind
+					// the others due at the same time)
+
+  private:
+    bool Before(PendingInterrupt *a, PendingInterrupt *b)
+	{ return (a->when < b->when) 
+		 || ((a->when == b->when) && (a->order < b->order)); }
+    void Place(PendingInterrupt *item, int i);	// put item at heap[i]
+    void SiftUp(int i);
+    void SiftDown(int i);
+    int CountTies(int i, int when);	// FrontCount, in the subtree at i
+
+    PendingInterrupt **heap;		// heap[0] is the first due; the
+					// children of heap[i] are 
+					// heap[2i+1] and heap[2i+2]
+    int numPending, size;		// entries used, and allocated
+    unsigned nextOrder;			// to number the inserts
+    PendingInterrupt *freeList;		// the pool of unused elements
 };
 
 // The following class defines the data structures for the simulation
@@ -94,6 +150,11 @@ class Interrupt {
     
     void YieldOnReturn();		// cause a context switch on return 
 					// from an interrupt handler
+    void YieldSoon();			// cause one once interrupts are next
+					// re-enabled (from kernel code)
+    void CheckpointOnReturn();		// take a checkpoint on return from
+					// an interrupt handler, if the
+					// interrupted thread is in user code
 
     MachineStatus getStatus() { return status; } // idle, kernel, user
     void setStatus(MachineStatus st) { status = st; }
@@ -109,22 +170,43 @@ class Interrupt {
     void Schedule(VoidFunctionPtr handler,// Schedule an interrupt to occur
 	int arg, int when, IntType type);// at time ``when''.  This is called
     					// by the hardware device simulators.
+    void Unschedule(VoidFunctionPtr handler, int arg);
+					// Take back an interrupt scheduled
+					// to call "handler" with "arg"
     
     void OneTick();       		// Advance simulated time
 
+    int Horizon();			// Return when the next pending
+					// interrupt is due.  Until then,
+					// user instructions may advance
+					// the simulated time themselves,
+					// without calling OneTick.
+
+    bool NextTimerInterrupt(int *when);	// When is the timer due?  FALSE 
+					// if any other interrupt is pending
+    void MoveTimerInterrupt(int when);	// Make it due at "when" instead,
+					// dropping any other interrupts
+
   private:
     IntStatus level;		// are interrupts enabled or disabled?
-    List *pending;		// the list of interrupts scheduled
-				// to occur in the future
+    PendingQueue *pending;	// the interrupts scheduled to occur
+				// in the future
     bool inHandler;		// TRUE if we are running an interrupt handler
     bool yieldOnReturn; 	// TRUE if we are to context switch
 				// on return from the interrupt handler
+    bool checkpointOnReturn;	// TRUE if we are to take a checkpoint
+				// on return from the interrupt handler
     MachineStatus status;	// idle, kernel mode, user mode
+    bool skipping;		// TRUE if user ticks are being counted
+				// without calling OneTick (see Horizon)
+    int skipFrom;		// the time when skipping started
 
     // these functions are internal to the interrupt simulation code
 
     bool CheckIfDue(bool advanceClock); // Check if an interrupt is supposed
 					// to occur now
+    void CatchUp();			// Bring the pending list up to date
+					// after ticks skipped past OneTick
 
     void ChangeLevel(IntStatus old, 	// SetLevel, without advancing the
 	IntStatus now);  		// simulated time
@@ -50,9 +50,14 @@ void CheckEndian()
 //
 //	"debug" -- if TRUE, drop into the debugger after each user instruction
 //		is executed.
+//	"blocks" -- if TRUE, run user programs a basic block at a time
+//		(see Machine::RunBlocks).
+//	"batch" -- if TRUE, only call Interrupt::OneTick for the user
+//		instructions at which an interrupt may be due (see
+//		Machine::Horizon).
 //----------------------------------------------------------------------
 
-Machine::Machine(bool debug)
+Machine::Machine(bool debug, bool blocks, bool batch)
 {
     int i;
 
@@ -62,17 +67,27 @@ Machine::Machine(bool debug)
     for (i = 0; i < MemorySize; i++)
       	mainMemory[i] = 0;
 
-#ifdef USE_TLB
-    tlb = new TranslationEntry[TLBSize];
-    for (i = 0; i < TLBSize; i++)
-	tlb[i].valid = FALSE;
-    KernelPageTable = NULL;
-#else	// use linear page table
     tlb = NULL;
+    tlbLastUse = NULL;
+    tlbSize = tlbWays = 0;
     KernelPageTable = NULL;
+    icache = dcache = NULL;
+    cacheMissPenalty = 0;
+#ifdef USE_TLB
+    EnableTLB(TLBSize, TLBSize);	// fully associative
 #endif
 
+    for (i = 0; i < NumPhysPages; i++) {
+	decodedPages[i] = NULL;
+	blockLengths[i] = NULL;
+    }
+    blockEpoch = 0;
+
     singleStep = debug;
+    useBlocks = blocks;
+    batchTicks = batch;
+    useSoftTLB = (tlb == NULL) && !DebugIsEnabled('a');
+    FlushSoftTLB();
     CheckEndian();
 }
 
@@ -84,8 +99,44 @@ Machine::Machine(bool debug)
 Machine::~Machine()
 {
     delete [] mainMemory;
-    if (tlb != NULL)
+    for (int i = 0; i < NumPhysPages; i++)
+	InvalidateDecodedPage(i);
+    if (tlb != NULL) {
         delete [] tlb;
+	delete [] tlbLastUse;
+    }
+    delete icache;
+    delete dcache;
+}
+
+//----------------------------------------------------------------------
+// Machine::EnableTLB
+// 	Translate addresses through a software-loaded TLB, rather than
+//	through the page table.  The TLB starts out empty; the kernel
+//	fills it when a translation misses (raising PageFaultException).
+//
+//	"size" -- the number of entries in the TLB
+//	"ways" -- the number of entries in each set (a divisor of "size";
+//		equal to "size" for a fully associative TLB)
+//----------------------------------------------------------------------
+
+void
+Machine::EnableTLB(int size, int ways)
+{
+    ASSERT((size > 0) && (ways > 0) && ((size % ways) == 0));
+    if (tlb != NULL) {
+        delete [] tlb;
+	delete [] tlbLastUse;
+    }
+    tlb = new TranslationEntry[size];
+    tlbLastUse = new int[size];
+    for (int i = 0; i < size; i++) {
+	tlb[i].valid = FALSE;
+	tlbLastUse[i] = 0;
+    }
+    tlbSize = size;
+    tlbWays = ways;
+    useSoftTLB = FALSE;
 }
 
 //----------------------------------------------------------------------
@@ -105,12 +156,34 @@ Machine::RaiseException(ExceptionType which, int badVAddr)
     
 //  ASSERT(interrupt->getStatus() == UserMode);
     registers[BadVAddrReg] = badVAddr;
+    blockEpoch++;			// the kernel may change anything
+    if ((profiler != NULL) && (which != SyscallException)
+				&& (interrupt->getStatus() == UserMode))
+	profiler->Retract(registers[PCReg]);	// it will be run again
     DelayedLoad(0, 0);			// finish anything in progress
     interrupt->setStatus(SystemMode);
     ExceptionHandler(which);		// interrupts are enabled at this point
     interrupt->setStatus(UserMode);
 }
 
+//----------------------------------------------------------------------
+// Machine::Horizon
+// 	Return the time before which the user instructions we are about
+//	to run can advance the simulated time themselves, instead of
+//	calling Interrupt::OneTick (which would find nothing to do).
+//	Returns 0 if they can't, because batching was not asked for, or
+//	we are single stepping, or interrupt debugging wants to print
+//	every tick, or there are several CPUs taking turns.
+//----------------------------------------------------------------------
+
+int
+Machine::Horizon()
+{
+    if (!batchTicks || singleStep || DebugIsEnabled('i') || (numCPUs > 1))
+	return 0;
+    return interrupt->Horizon();
+}
+
 //----------------------------------------------------------------------
 // Machine::Debugger
 // 	Primitive debugger for user programs.  Note that we can't use
@@ -24,6 +24,7 @@
 #include "copyright.h"
 #include "utility.h"
 #include "translate.h"
+#include "cache.h"
 #include "disk.h"
 
 // Definitions related to the size, and format of user memory
@@ -36,6 +37,8 @@
 #define NumPhysPages    512
 #define MemorySize 	(NumPhysPages * PageSize)
 #define TLBSize		4		// if there is a TLB, make it small
+#define SoftTLBSize	16		// translations cached by the simulator
+					// itself (must be a power of two)
 
 enum ExceptionType { NoException,           // Everything ok!
 		     SyscallException,      // A program executed a system call.
@@ -92,6 +95,23 @@ class Instruction {
                      // Immediates are sign-extended.
 };
 
+extern bool EndsBlock(Instruction *instr);	// Is it a branch or jump?
+
+// The following class defines an entry in a small direct-mapped cache
+// of recent page table translations, kept by the simulator for its own
+// use, so that loads, stores and instruction fetches can usually skip
+// Translate.  Unlike the TLB, user programs and the kernel can't see it,
+// except that the kernel must flush it whenever a page table changes.
+
+class SoftTLBEntry {
+  public:
+    int virtualPage;		// -1 if the entry is empty
+    int physicalPage;		// the page frame it maps to
+    TranslationEntry *entry;	// the page table entry it was filled from
+    bool writable;		// TRUE once a store to the page has been
+				// translated (and has marked it dirty)
+};
+
 // The following class defines the simulated host workstation hardware, as 
 // seen by user programs -- the CPU registers, main memory, etc.
 // User programs shouldn't be able to tell that they are running on our 
@@ -107,7 +127,8 @@ class Instruction {
 
 class Machine {
   public:
-    Machine(bool debug);	// Initialize the simulation of the hardware
+    Machine(bool debug, bool blocks, bool batch);
+				// Initialize the simulation of the hardware
 				// for running user programs
     ~Machine();			// De-allocate the data structures
 
@@ -121,9 +142,25 @@ class Machine {
 
 
 // Routines internal to the machine simulation -- DO NOT call these 
-
-    void OneInstruction(Instruction *instr); 	
+//
+// Most of them are templates, compiled once for each variant of the 
+// simulator: "Trace" is TRUE if debug output, profiling or the cache
+// models may be on, "Step" if single stepping may be on, and "UseTLB" 
+// if addresses are translated through the TLB (see Machine::Run).
+
+    template <bool Trace, bool Step, bool UseTLB> void RunLoop();
+				// Run a user program, an instruction at
+				// a time
+    template <bool Trace, bool UseTLB> 
+    bool OneInstruction(Instruction *instr); 	
     				// Run one instruction of a user program.
+				// Return FALSE if it raised an exception.
+    template <bool Trace, bool UseTLB> 
+    bool ExecuteInstruction(Instruction *instr);
+				// Execute an already fetched instruction.
+				// Return FALSE if it raised an exception.
+    template <bool Trace, bool UseTLB> void RunBlocks();
+				// Run a user program a basic block at a time
     void DelayedLoad(int nextReg, int nextVal);  	
 				// Do a pending delayed load (modifying a reg)
     
@@ -132,7 +169,47 @@ class Machine {
     				// Read or write 1, 2, or 4 bytes of virtual 
 				// memory (at addr).  Return FALSE if a 
 				// correct translation couldn't be found.
+    template <bool Trace, bool UseTLB> 
+    bool ReadMem(int addr, int size, int* value);
+    template <bool Trace, bool UseTLB> 
+    bool WriteMem(int addr, int size, int value);
+				// The same, for the simulator
+
+    template <bool Trace, bool UseTLB> 
+    bool FetchInstruction(int addr, Instruction *instr);
+				// Fetch and decode the instruction at addr,
+				// reusing the cached decoding of its physical
+				// page when there is one.  Return FALSE if
+				// the fetch raised an exception.
+
+    void InvalidateDecodedPage(int physPage);
+				// Forget the cached decodings of a physical
+				// page (and its lines in the caches), 
+				// because its contents were replaced
+    void CacheAccess(Cache *cache, int physAddr);
+				// Model an access through the I or D cache
+
+    template <bool Trace, bool UseTLB> 
+    Instruction *FetchBlock(int addr, int *length, int *physPage);
+				// Translate addr, and return the decoded
+				// basic block starting there, its length
+				// and its physical page.
+				// Return NULL if translation raised an
+				// exception.
+    Instruction *CarveBlock(int physAddr, int *length);
+				// Return the decoded basic block starting at
+				// a physical address, splitting it out of its
+				// page the first time it is executed
     
+    template <bool Trace, bool UseTLB> 
+    ExceptionType CachedTranslate(int virtAddr, int* physAddr, int size,
+				  bool writing);
+				// Translate, going through the soft TLB
+    void FlushSoftTLB();	// Empty the soft TLB; the kernel must call
+				// this when it changes the page table
+
+    ExceptionType Translate(int virtAddr, int* physAddr, int size,bool writing);
+    template <bool Trace, bool UseTLB> 
     ExceptionType Translate(int virtAddr, int* physAddr, int size,bool writing);
     				// Translate an address, and check for 
 				// alignment.  Set the use and dirty bits in 
@@ -147,6 +224,9 @@ class Machine {
 				// Trap to the Nachos kernel, because of a
 				// system call or other exception.  
 
+    int Horizon();		// time up to which user instructions can
+				// skip calling OneTick (0 if they can't)
+
     void Debugger();		// invoke the user program debugger
     void DumpState();		// print the user CPU and memory state 
 
@@ -181,13 +261,63 @@ class Machine {
 // Thus the TLB pointer should be considered as *read-only*, although 
 // the contents of the TLB are free to be modified by the kernel software.
 
+//
+// The TLB is set associative: it has tlbSize entries, in sets of tlbWays,
+// and a virtual page can only be held in set (vpn % (tlbSize/tlbWays)),
+// that is, in entries (vpn % (tlbSize/tlbWays)) * tlbWays onwards.
+// If there is a TLB, the page table pointer is only kept for the kernel's
+// benefit; the hardware ignores it.
+
     TranslationEntry *tlb;		// this pointer should be considered 
 					// "read-only" to Nachos kernel code
+    int tlbSize;			// number of entries in the TLB
+    int tlbWays;			// number of entries in each set
+    int *tlbLastUse;			// when each TLB entry was last used
+					// by a successful translation
+
+    void EnableTLB(int size, int ways);	// Replace the TLB (if any) by
+					// an empty one with "size" entries,
+					// "ways" to a set
+
+// The L1 caches are only modelled if asked for (NULL otherwise).  User
+// instruction fetches go through the I-cache, user loads and stores 
+// through the D-cache, and each miss adds cacheMissPenalty ticks.
+
+    Cache *icache;
+    Cache *dcache;
+    int cacheMissPenalty;
 
     TranslationEntry *KernelPageTable;
     unsigned int KernelPageTableSize;
 
   private:
+    Instruction *DecodedPage(int physPage);
+				// The decoded instructions of a physical
+				// page, allocated on first use
+
+    Instruction *decodedPages[NumPhysPages];
+				// Decoded instructions of each physical page,
+				// filled on first execution (NULL if none
+				// have been executed since the page was
+				// last loaded).  An opCode of zero marks a
+				// word that has not been decoded yet.
+    unsigned short *blockLengths[NumPhysPages];
+				// For each decoded word, the number of
+				// instructions in the basic block starting
+				// there (zero if not worked out yet)
+    unsigned int blockEpoch;	// bumped whenever a running basic block
+				// may no longer be valid (a trap into the
+				// kernel, or code being overwritten)
+    bool useBlocks;		// run user programs a basic block at a time
+    bool batchTicks;		// let user instructions skip OneTick while
+				// no interrupt can be due
+
+    SoftTLBEntry softTLB[SoftTLBSize];
+				// recent page table translations, indexed
+				// by virtual page number modulo SoftTLBSize
+    bool useSoftTLB;		// FALSE if there is a real TLB, or if
+				// address translation is being debugged
+
     bool singleStep;		// drop back into the debugger after each
 				// simulated instruction
     int runUntilTime;		// drop back into the debugger when simulated
@@ -198,6 +328,10 @@ extern void ExceptionHandler(ExceptionType which);
 				// Entry point into Nachos for handling
 				// user system calls and exceptions
 				// Defined in exception.cc
+extern int CopyStringFromUser(int vaddr, char *buffer, int size);
+				// Copy a string from the current user
+				// program's memory, a page at a time
+				// Defined in exception.cc
 
 
 // Routines for converting Words and Short Words to and from the
@@ -25,25 +25,97 @@ static void Mult(int a, int b, bool signedArith, int* hiPtr, int* loPtr);
 //
 //	This routine is re-entrant, in that it can be called multiple
 //	times concurrently -- one for each thread executing user code.
+//
+//	The simulator loop (RunLoop, or RunBlocks in basic block mode)
+//	is compiled in several variants, each with its own setting of
+//	"Trace" (the 'm' and 'a' debug flags, profiling, or the cache 
+//	models may be on),
+//	"Step" (single stepping may be on) and "UseTLB" (translate
+//	through the TLB rather than the page table).  We pick the one
+//	to use here, once; the usual one, with none of these, has no
+//	tracing or single stepping code in it at all.
+//
+//	Basic block mode is only used when we are not single stepping,
+//	profiling or modelling the I-cache, and there is only one CPU.  If THREADED_DISPATCH
+//	is defined, RunLoop is the direct-threaded version further 
+//	down, and basic block mode is not available.
 //----------------------------------------------------------------------
 
+typedef void (Machine::*RunLoopPtr)();
+
 void
 Machine::Run()
 {
-    Instruction *instr = new Instruction;  // storage for decoded instruction
+    static RunLoopPtr loops[2][2][2] = {	// by Trace, Step, UseTLB
+	{ { &Machine::RunLoop<false, false, false>,
+	    &Machine::RunLoop<false, false, true> },
+	  { &Machine::RunLoop<false, true, false>,
+	    &Machine::RunLoop<false, true, true> } },
+	{ { &Machine::RunLoop<true, false, false>,
+	    &Machine::RunLoop<true, false, true> },
+	  { &Machine::RunLoop<true, true, false>,
+	    &Machine::RunLoop<true, true, true> } }
+    };
+    bool trace = DebugIsEnabled('m') || DebugIsEnabled('a')
+		|| (profiler != NULL) || (icache != NULL) || (dcache != NULL);
+    bool useTLB = (tlb != NULL);
 
     if(DebugIsEnabled('m'))
         printf("Starting thread \"%s\" at time %d\n",
 	       currentThread->getName(), stats->totalTicks);
     interrupt->setStatus(UserMode);
+#ifndef THREADED_DISPATCH
+    static RunLoopPtr blockLoops[2][2] = {	// by Trace, UseTLB
+	{ &Machine::RunBlocks<false, false>, &Machine::RunBlocks<false, true> },
+	{ &Machine::RunBlocks<true, false>, &Machine::RunBlocks<true, true> }
+    };
+
+    if (useBlocks && !singleStep && (numCPUs == 1) && (profiler == NULL)
+							&& (icache == NULL))
+	(this->*blockLoops[trace][useTLB])();	// never returns
+#endif
+    (this->*loops[trace][singleStep][useTLB])();	// never returns
+}
+
+#ifndef THREADED_DISPATCH
+//----------------------------------------------------------------------
+// Machine::RunLoop
+// 	The simulator main loop, in the variant picked by Run (which
+//	see); never returns.
+//
+//	Interrupt::OneTick is only called for the instructions at which
+//	an interrupt could be due, or which trapped into the kernel, if
+//	Horizon allows it; for the others, we advance the time ourselves.
+//	With several CPUs, ProcessScheduler::NextCPU is called instead,
+//	after every instruction; it calls OneTick once all the CPUs 
+//	have had their turn.
+//----------------------------------------------------------------------
+
+template <bool Trace, bool Step, bool UseTLB>
+void
+Machine::RunLoop()
+{
+    Instruction *instr = new Instruction;  // storage for decoded instruction
+    int horizon = 0;			// no interrupt is due before this time
+
     for (;;) {
         currentThread->IncInstructionCount();
-        OneInstruction(instr);
-	interrupt->OneTick();
-	if (singleStep && (runUntilTime <= stats->totalTicks))
+        if (OneInstruction<Trace, UseTLB>(instr)
+		&& (stats->totalTicks + UserTick < horizon)) {
+	    stats->totalTicks += UserTick;	// no interrupt can be due yet
+	    stats->userTicks += UserTick;
+	    continue;
+	}
+	if (numCPUs > 1)
+	    scheduler->NextCPU();	// the other CPUs take their turn
+	else
+	    interrupt->OneTick();
+	if (Step && singleStep && (runUntilTime <= stats->totalTicks))
 	  Debugger();
+	horizon = Horizon();
     }
 }
+#endif // THREADED_DISPATCH
 
 
 //----------------------------------------------------------------------
@@ -68,6 +140,24 @@ TypeToReg(RegType reg, Instruction *instr)
     }
 }
 
+//----------------------------------------------------------------------
+// PrintInstruction
+// 	Print the instruction about to be executed at "pc", for the 'm'
+//	debug flag.
+//----------------------------------------------------------------------
+
+static void
+PrintInstruction(int pc, Instruction *instr)
+{
+    struct OpString *str = &opStrings[instr->opCode];
+
+    ASSERT(instr->opCode <= MaxOpcode);
+    printf("At PC = 0x%x: ", pc);
+    printf(str->string, TypeToReg(str->args[0], instr), 
+	     TypeToReg(str->args[1], instr), TypeToReg(str->args[2], instr));
+    printf("\n");
+}
+
 //----------------------------------------------------------------------
 // Machine::OneInstruction
 // 	Execute one instruction from a user-level program
@@ -91,30 +181,39 @@ TypeToReg(RegType reg, Instruction *instr)
 //	and the register set.
 //----------------------------------------------------------------------
 
-void
+template <bool Trace, bool UseTLB>
+bool
 Machine::OneInstruction(Instruction *instr)
 {
-    int raw;
+    // Fetch instruction 
+    if (!FetchInstruction<Trace, UseTLB>(registers[PCReg], instr))
+	return FALSE;			// exception occurred
+
+    if (Trace && (profiler != NULL))
+	profiler->CountInstruction(registers[PCReg], instr);
+    if (Trace && DebugIsEnabled('m'))
+       PrintInstruction(registers[PCReg], instr);
+    return ExecuteInstruction<Trace, UseTLB>(instr);
+}
+
+//----------------------------------------------------------------------
+// Machine::ExecuteInstruction
+// 	Execute an instruction that has already been fetched from the PC,
+//	and advance the program counters past it.
+//
+//	Returns FALSE if the instruction raised an exception, in which
+//	case the kernel has already handled it, and the PC is whatever
+//	the kernel left it at.
+//----------------------------------------------------------------------
+
+template <bool Trace, bool UseTLB>
+bool
+Machine::ExecuteInstruction(Instruction *instr)
+{
     int nextLoadReg = 0; 	
     int nextLoadValue = 0; 	// record delayed load operation, to apply
 				// in the future
 
-    // Fetch instruction 
-    if (!machine->ReadMem(registers[PCReg], 4, &raw))
-	return;			// exception occurred
-    instr->value = raw;
-    instr->Decode();
-
-    if (DebugIsEnabled('m')) {
-       struct OpString *str = &opStrings[instr->opCode];
-
-       ASSERT(instr->opCode <= MaxOpcode);
-       printf("At PC = 0x%x: ", registers[PCReg]);
-       printf(str->string, TypeToReg(str->args[0], instr), 
-		TypeToReg(str->args[1], instr), TypeToReg(str->args[2], instr));
-       printf("\n");
-       }
-    
     // Compute next pc, but don't install in case there's an error or branch.
     int pcAfter = registers[NextPCReg] + 4;
     int sum, diff, tmp, value;
@@ -128,7 +227,7 @@ Machine::OneInstruction(Instruction *instr)
 	if (!((registers[instr->rs] ^ registers[instr->rt]) & SIGN_BIT) &&
 	    ((registers[instr->rs] ^ sum) & SIGN_BIT)) {
 	    RaiseException(OverflowException, 0);
-	    return;
+	    return FALSE;
 	}
 	registers[instr->rd] = sum;
 	break;
@@ -138,7 +237,7 @@ Machine::OneInstruction(Instruction *instr)
 	if (!((registers[instr->rs] ^ instr->extra) & SIGN_BIT) &&
 	    ((instr->extra ^ sum) & SIGN_BIT)) {
 	    RaiseException(OverflowException, 0);
-	    return;
+	    return FALSE;
 	}
 	registers[instr->rt] = sum;
 	break;
@@ -232,8 +331,8 @@ Machine::OneInstruction(Instruction *instr)
       case OP_LB:
       case OP_LBU:
 	tmp = registers[instr->rs] + instr->extra;
-	if (!machine->ReadMem(tmp, 1, &value))
-	    return;
+	if (!ReadMem<Trace, UseTLB>(tmp, 1, &value))
+	    return FALSE;
 
 	if ((value & 0x80) && (instr->opCode == OP_LB))
 	    value |= 0xffffff00;
@@ -248,10 +347,10 @@ Machine::OneInstruction(Instruction *instr)
 	tmp = registers[instr->rs] + instr->extra;
 	if (tmp & 0x1) {
 	    RaiseException(AddressErrorException, tmp);
-	    return;
+	    return FALSE;
 	}
-	if (!machine->ReadMem(tmp, 2, &value))
-	    return;
+	if (!ReadMem<Trace, UseTLB>(tmp, 2, &value))
+	    return FALSE;
 
 	if ((value & 0x8000) && (instr->opCode == OP_LH))
 	    value |= 0xffff0000;
@@ -262,7 +361,8 @@ Machine::OneInstruction(Instruction *instr)
 	break;
       	
       case OP_LUI:
-	DEBUG('m', "Executing: LUI r%d,%d\n", instr->rt, instr->extra);
+	if (Trace)
+	    DEBUG('m', "Executing: LUI r%d,%d\n", instr->rt, instr->extra);
 	registers[instr->rt] = instr->extra << 16;
 	break;
 	
@@ -270,10 +370,10 @@ Machine::OneInstruction(Instruction *instr)
 	tmp = registers[instr->rs] + instr->extra;
 	if (tmp & 0x3) {
 	    RaiseException(AddressErrorException, tmp);
-	    return;
+	    return FALSE;
 	}
-	if (!machine->ReadMem(tmp, 4, &value))
-	    return;
+	if (!ReadMem<Trace, UseTLB>(tmp, 4, &value))
+	    return FALSE;
 	nextLoadReg = instr->rt;
 	nextLoadValue = value;
 	break;
@@ -286,8 +386,8 @@ Machine::OneInstruction(Instruction *instr)
         // fail (I think) if the other cases are ever exercised.
 	ASSERT((tmp & 0x3) == 0);  
 
-	if (!machine->ReadMem(tmp, 4, &value))
-	    return;
+	if (!ReadMem<Trace, UseTLB>(tmp, 4, &value))
+	    return FALSE;
 	if (registers[LoadReg] == instr->rt)
 	    nextLoadValue = registers[LoadValueReg];
 	else
@@ -317,8 +417,8 @@ Machine::OneInstruction(Instruction *instr)
         // fail (I think) if the other cases are ever exercised.
 	ASSERT((tmp & 0x3) == 0);  
 
-	if (!machine->ReadMem(tmp, 4, &value))
-	    return;
+	if (!ReadMem<Trace, UseTLB>(tmp, 4, &value))
+	    return FALSE;
 	if (registers[LoadReg] == instr->rt)
 	    nextLoadValue = registers[LoadValueReg];
 	else
@@ -382,15 +482,15 @@ Machine::OneInstruction(Instruction *instr)
 	break;
 	
       case OP_SB:
-	if (!machine->WriteMem((unsigned) 
+	if (!WriteMem<Trace, UseTLB>((unsigned) 
 		(registers[instr->rs] + instr->extra), 1, registers[instr->rt]))
-	    return;
+	    return FALSE;
 	break;
 	
       case OP_SH:
-	if (!machine->WriteMem((unsigned) 
+	if (!WriteMem<Trace, UseTLB>((unsigned) 
 		(registers[instr->rs] + instr->extra), 2, registers[instr->rt]))
-	    return;
+	    return FALSE;
 	break;
 	
       case OP_SLL:
@@ -460,7 +560,7 @@ Machine::OneInstruction(Instruction *instr)
 	if (((registers[instr->rs] ^ registers[instr->rt]) & SIGN_BIT) &&
 	    ((registers[instr->rs] ^ diff) & SIGN_BIT)) {
 	    RaiseException(OverflowException, 0);
-	    return;
+	    return FALSE;
 	}
 	registers[instr->rd] = diff;
 	break;
@@ -470,9 +570,9 @@ Machine::OneInstruction(Instruction *instr)
 	break;
 	
       case OP_SW:
-	if (!machine->WriteMem((unsigned) 
+	if (!WriteMem<Trace, UseTLB>((unsigned) 
 		(registers[instr->rs] + instr->extra), 4, registers[instr->rt]))
-	    return;
+	    return FALSE;
 	break;
 	
       case OP_SWL:	  
@@ -482,8 +582,8 @@ Machine::OneInstruction(Instruction *instr)
         // fail (I think) if the other cases are ever exercised.
 	ASSERT((tmp & 0x3) == 0);  
 
-	if (!machine->ReadMem((tmp & ~0x3), 4, &value))
-	    return;
+	if (!ReadMem<Trace, UseTLB>((tmp & ~0x3), 4, &value))
+	    return FALSE;
 	switch (tmp & 0x3) {
 	  case 0:
 	    value = registers[instr->rt];
@@ -501,8 +601,8 @@ Machine::OneInstruction(Instruction *instr)
 					    0xff);
 	    break;
 	}
-	if (!machine->WriteMem((tmp & ~0x3), 4, value))
-	    return;
+	if (!WriteMem<Trace, UseTLB>((tmp & ~0x3), 4, value))
+	    return FALSE;
 	break;
     	
       case OP_SWR:	  
@@ -512,8 +612,8 @@ Machine::OneInstruction(Instruction *instr)
         // fail (I think) if the other cases are ever exercised.
 	ASSERT((tmp & 0x3) == 0);  
 
-	if (!machine->ReadMem((tmp & ~0x3), 4, &value))
-	    return;
+	if (!ReadMem<Trace, UseTLB>((tmp & ~0x3), 4, &value))
+	    return FALSE;
 	switch (tmp & 0x3) {
 	  case 0:
 	    value = (value & 0xffffff) | (registers[instr->rt] << 24);
@@ -528,13 +628,13 @@ Machine::OneInstruction(Instruction *instr)
 	    value = registers[instr->rt];
 	    break;
 	}
-	if (!machine->WriteMem((tmp & ~0x3), 4, value))
-	    return;
+	if (!WriteMem<Trace, UseTLB>((tmp & ~0x3), 4, value))
+	    return FALSE;
 	break;
     	
       case OP_SYSCALL:
 	RaiseException(SyscallException, 0);
-	return; 
+	return FALSE; 
 	
       case OP_XOR:
 	registers[instr->rd] = registers[instr->rs] ^ registers[instr->rt];
@@ -547,7 +647,7 @@ Machine::OneInstruction(Instruction *instr)
       case OP_RES:
       case OP_UNIMP:
 	RaiseException(IllegalInstrException, 0);
-	return;
+	return FALSE;
 	
       default:
 	ASSERT(FALSE);
@@ -563,8 +663,690 @@ Machine::OneInstruction(Instruction *instr)
 						// are jumping into lala-land
     registers[PCReg] = registers[NextPCReg];
     registers[NextPCReg] = pcAfter;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// EndsBlock
+// 	Return TRUE if the instruction is a branch or jump, which (with
+//	its delay slot) ends a basic block.
+//----------------------------------------------------------------------
+
+bool
+EndsBlock(Instruction *instr)
+{
+    switch (instr->opCode) {
+      case OP_BEQ:
+      case OP_BGEZ:
+      case OP_BGEZAL:
+      case OP_BGTZ:
+      case OP_BLEZ:
+      case OP_BLTZ:
+      case OP_BLTZAL:
+      case OP_BNE:
+      case OP_J:
+      case OP_JAL:
+      case OP_JALR:
+      case OP_JR:
+	return TRUE;
+      default:
+	return FALSE;
+    }
+}
+
+//----------------------------------------------------------------------
+// Machine::CarveBlock
+// 	Return the basic block starting at physical address "physAddr":
+//	the run of decoded instructions up to and including the delay slot
+//	of the first branch or jump, or up to the end of the page, which
+//	ever comes first.
+//
+//	The block is worked out (decoding its instructions) the first time
+//	it is needed, and remembered in blockLengths until the page is
+//	reloaded or one of the page's instructions is overwritten.
+//
+//	"physAddr" -- the physical address of the first instruction
+//	"length" -- the place to store the number of instructions
+//----------------------------------------------------------------------
+
+Instruction *
+Machine::CarveBlock(int physAddr, int *length)
+{
+    int page = physAddr / PageSize;
+    int first = (physAddr % PageSize) >> 2;
+    Instruction *decoded = DecodedPage(page);
+    int i;
+
+    if (blockLengths[page][first] == 0) {
+	for (i = first; i < PageSize/4; i++) {
+	    if (decoded[i].opCode == 0) {		// not decoded yet
+		decoded[i].value = WordToHost(*(unsigned int *)
+			&mainMemory[page * PageSize + (i << 2)]);
+		decoded[i].Decode();
+	    }
+	    if (EndsBlock(&decoded[i])) {
+		i += 2;				// keep the delay slot
+		break;
+	    }
+	}
+	if (i > PageSize/4)			// delay slot is on next page
+	    i = PageSize/4;
+	blockLengths[page][first] = i - first;
+    }
+    *length = blockLengths[page][first];
+    return &decoded[first];
+}
+
+//----------------------------------------------------------------------
+// Machine::RunBlocks
+// 	Simulate the execution of a user-level program, a basic block
+//	at a time.  Called by Run when basic block mode is on; never
+//	returns.
+//
+//	Translation is only done at the start of a block.  The block's
+//	instructions, already decoded, are then executed back to back,
+//	and when it ends, the next block is chained to directly if it
+//	is on the same virtual page, without translating again.
+//
+//	Everything else is done exactly as Run and OneInstruction do it:
+//	every instruction is counted, ticks the clock, and updates the
+//	LRU information of its page.  We stop following the current
+//	page as soon as something could have changed underneath us,
+//	that is, whenever blockEpoch changes (an exception, or a
+//	context switch to a thread that trapped into the kernel, or
+//	code being overwritten).
+//----------------------------------------------------------------------
+
+template <bool Trace, bool UseTLB>
+void
+Machine::RunBlocks()
+{
+    Instruction *block;
+    unsigned int epoch;
+    int length, i, vpn, page, pc;
+    int horizon = 0;			// no interrupt is due before this time
+
+    for (;;) {
+        currentThread->IncInstructionCount();
+	pc = registers[PCReg];
+	block = FetchBlock<Trace, UseTLB>(pc, &length, &page);
+	if (block == NULL) {		// exception occurred
+	    interrupt->OneTick();
+	    horizon = Horizon();
+	    continue;
+	}
+	epoch = blockEpoch;
+	vpn = (unsigned) pc / PageSize;
+	for (;;) {
+	    if (registers[NextPCReg] != pc + 4)	// in a branch delay slot
+		length = 1;
+	    for (i = 0; i < length; i++) {
+		if (i > 0) {
+		    currentThread->IncInstructionCount();
+		    physpage_LRU[page] = stats->totalTicks;
+		    physpage_LRUclock[page] = 1;
+		}
+		if (Trace && DebugIsEnabled('m'))
+		    PrintInstruction(registers[PCReg], &block[i]);
+		if (!ExecuteInstruction<Trace, UseTLB>(&block[i])) {
+		    interrupt->OneTick();
+		    horizon = Horizon();
+		    break;
+		}
+		if (stats->totalTicks + UserTick < horizon) {
+		    stats->totalTicks += UserTick;
+		    stats->userTicks += UserTick;
+		} else {
+		    interrupt->OneTick();
+		    horizon = Horizon();
+		}
+		if (blockEpoch != epoch)	// (a store may have overwritten
+		    break;			// the rest of the block)
+	    }
+	    if ((i < length) || (blockEpoch != epoch))
+		break;
+
+	    // chain to the next block, if it is on the same page
+	    pc = registers[PCReg];
+	    if ((unsigned) pc / PageSize != (unsigned) vpn)
+		break;
+	    currentThread->IncInstructionCount();
+	    physpage_LRU[page] = stats->totalTicks;
+	    physpage_LRUclock[page] = 1;
+	    block = CarveBlock(page * PageSize + pc % PageSize, &length);
+	}
+    }
+}
+
+#ifdef THREADED_DISPATCH
+//----------------------------------------------------------------------
+// Machine::RunLoop
+// 	Direct-threaded version of the simulator main loop, compiled in
+//	instead of the switch-based RunLoop/OneInstruction pair when
+//	THREADED_DISPATCH is defined.  Like the other version, it comes
+//	in the variants picked by Run.
+//
+//	Each opcode has its own handler, found through a table of label
+//	addresses (a gcc extension).  Instead of returning to a common
+//	loop, every handler retires its instruction, advances simulated
+//	time, fetches the next instruction and jumps straight to that
+//	instruction's handler, so each handler ends in its own (better
+//	predicted) indirect branch.
+//
+//	The semantics are exactly those of OneInstruction: delayed loads
+//	go through DelayedLoad, branches only change the PC after the
+//	delay slot, and an instruction that raises an exception leaves
+//	the registers alone (the exception handler may have changed them).
+//
+//	Like the other version, this routine never returns.
+//----------------------------------------------------------------------
+
+// Advance simulated time after an instruction, exactly as the
+// switch-based Run does.
+#define TICK								\
+    if (numCPUs > 1)							\
+	scheduler->NextCPU();						\
+    else								\
+	interrupt->OneTick();						\
+    if (Step && singleStep && (runUntilTime <= stats->totalTicks))	\
+	Debugger();							\
+    horizon = Horizon()
+
+// Fetch the instruction at the PC and jump to its handler.
+#define FETCH_AND_DISPATCH						\
+    currentThread->IncInstructionCount();				\
+    if (!FetchInstruction<Trace, UseTLB>(registers[PCReg], instr))	\
+	goto trapped;							\
+    if (Trace && (profiler != NULL))					\
+	profiler->CountInstruction(registers[PCReg], instr);		\
+    if (Trace && DebugIsEnabled('m'))					\
+	PrintInstruction(registers[PCReg], instr);			\
+    nextLoadReg = 0;							\
+    nextLoadValue = 0;							\
+    pcAfter = registers[NextPCReg] + 4;					\
+    goto *handlers[(int) instr->opCode]
+
+// The instruction completed: do the delayed load, advance the program
+// counters, and go on to the next instruction.
+#define NEXT_INSTRUCTION						\
+    DelayedLoad(nextLoadReg, nextLoadValue);				\
+    registers[PrevPCReg] = registers[PCReg];				\
+    registers[PCReg] = registers[NextPCReg];				\
+    registers[NextPCReg] = pcAfter;					\
+    if (stats->totalTicks + UserTick < horizon) {			\
+	stats->totalTicks += UserTick;					\
+	stats->userTicks += UserTick;					\
+    } else {								\
+	TICK;								\
+    }									\
+    FETCH_AND_DISPATCH
+
+template <bool Trace, bool Step, bool UseTLB>
+void
+Machine::RunLoop()
+{
+    Instruction *instr = new Instruction;  // storage for decoded instruction
+    static void *handlers[MaxOpcode + 1];
+    int i, nextLoadReg, nextLoadValue, pcAfter;
+    int horizon = 0;			// no interrupt is due before this time
+    int sum, diff, tmp, value;
+    unsigned int rs, rt, imm;
+
+    if (handlers[0] == NULL) {		// first time through, build the table
+	for (i = 0; i <= MaxOpcode; i++)
+	    handlers[i] = &&op_bad;
+	handlers[OP_ADD] = &&op_add;		handlers[OP_ADDI] = &&op_addi;
+	handlers[OP_ADDIU] = &&op_addiu;	handlers[OP_ADDU] = &&op_addu;
+	handlers[OP_AND] = &&op_and;		handlers[OP_ANDI] = &&op_andi;
+	handlers[OP_BEQ] = &&op_beq;		handlers[OP_BGEZ] = &&op_bgez;
+	handlers[OP_BGEZAL] = &&op_bgezal;	handlers[OP_BGTZ] = &&op_bgtz;
+	handlers[OP_BLEZ] = &&op_blez;		handlers[OP_BLTZ] = &&op_bltz;
+	handlers[OP_BLTZAL] = &&op_bltzal;	handlers[OP_BNE] = &&op_bne;
+	handlers[OP_DIV] = &&op_div;		handlers[OP_DIVU] = &&op_divu;
+	handlers[OP_J] = &&op_j;		handlers[OP_JAL] = &&op_jal;
+	handlers[OP_JALR] = &&op_jalr;		handlers[OP_JR] = &&op_jr;
+	handlers[OP_LB] = &&op_lb;		handlers[OP_LBU] = &&op_lb;
+	handlers[OP_LH] = &&op_lh;		handlers[OP_LHU] = &&op_lh;
+	handlers[OP_LUI] = &&op_lui;		handlers[OP_LW] = &&op_lw;
+	handlers[OP_LWL] = &&op_lwl;		handlers[OP_LWR] = &&op_lwr;
+	handlers[OP_MFHI] = &&op_mfhi;		handlers[OP_MFLO] = &&op_mflo;
+	handlers[OP_MTHI] = &&op_mthi;		handlers[OP_MTLO] = &&op_mtlo;
+	handlers[OP_MULT] = &&op_mult;		handlers[OP_MULTU] = &&op_multu;
+	handlers[OP_NOR] = &&op_nor;		handlers[OP_OR] = &&op_or;
+	handlers[OP_ORI] = &&op_ori;		handlers[OP_SB] = &&op_sb;
+	handlers[OP_SH] = &&op_sh;		handlers[OP_SLL] = &&op_sll;
+	handlers[OP_SLLV] = &&op_sllv;		handlers[OP_SLT] = &&op_slt;
+	handlers[OP_SLTI] = &&op_slti;		handlers[OP_SLTIU] = &&op_sltiu;
+	handlers[OP_SLTU] = &&op_sltu;		handlers[OP_SRA] = &&op_sra;
+	handlers[OP_SRAV] = &&op_srav;		handlers[OP_SRL] = &&op_srl;
+	handlers[OP_SRLV] = &&op_srlv;		handlers[OP_SUB] = &&op_sub;
+	handlers[OP_SUBU] = &&op_subu;		handlers[OP_SW] = &&op_sw;
+	handlers[OP_SWL] = &&op_swl;		handlers[OP_SWR] = &&op_swr;
+	handlers[OP_SYSCALL] = &&op_syscall;	handlers[OP_XOR] = &&op_xor;
+	handlers[OP_XORI] = &&op_xori;		handlers[OP_RES] = &&op_illegal;
+	handlers[OP_UNIMP] = &&op_illegal;
+    }
+
+    FETCH_AND_DISPATCH;
+
+  trapped:		// an exception was raised, the kernel has handled it
+    TICK;
+    FETCH_AND_DISPATCH;
+
+  op_add:
+    sum = registers[instr->rs] + registers[instr->rt];
+    if (!((registers[instr->rs] ^ registers[instr->rt]) & SIGN_BIT) &&
+	((registers[instr->rs] ^ sum) & SIGN_BIT)) {
+	RaiseException(OverflowException, 0);
+	goto trapped;
+    }
+    registers[instr->rd] = sum;
+    NEXT_INSTRUCTION;
+
+  op_addi:
+    sum = registers[instr->rs] + instr->extra;
+    if (!((registers[instr->rs] ^ instr->extra) & SIGN_BIT) &&
+	((instr->extra ^ sum) & SIGN_BIT)) {
+	RaiseException(OverflowException, 0);
+	goto trapped;
+    }
+    registers[instr->rt] = sum;
+    NEXT_INSTRUCTION;
+
+  op_addiu:
+    registers[instr->rt] = registers[instr->rs] + instr->extra;
+    NEXT_INSTRUCTION;
+
+  op_addu:
+    registers[instr->rd] = registers[instr->rs] + registers[instr->rt];
+    NEXT_INSTRUCTION;
+
+  op_and:
+    registers[instr->rd] = registers[instr->rs] & registers[instr->rt];
+    NEXT_INSTRUCTION;
+
+  op_andi:
+    registers[instr->rt] = registers[instr->rs] & (instr->extra & 0xffff);
+    NEXT_INSTRUCTION;
+
+  op_beq:
+    if (registers[instr->rs] == registers[instr->rt])
+	pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
+    NEXT_INSTRUCTION;
+
+  op_bgezal:
+    registers[R31] = registers[NextPCReg] + 4;
+  op_bgez:
+    if (!(registers[instr->rs] & SIGN_BIT))
+	pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
+    NEXT_INSTRUCTION;
+
+  op_bgtz:
+    if (registers[instr->rs] > 0)
+	pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
+    NEXT_INSTRUCTION;
+
+  op_blez:
+    if (registers[instr->rs] <= 0)
+	pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
+    NEXT_INSTRUCTION;
+
+  op_bltzal:
+    registers[R31] = registers[NextPCReg] + 4;
+  op_bltz:
+    if (registers[instr->rs] & SIGN_BIT)
+	pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
+    NEXT_INSTRUCTION;
+
+  op_bne:
+    if (registers[instr->rs] != registers[instr->rt])
+	pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
+    NEXT_INSTRUCTION;
+
+  op_div:
+    if (registers[instr->rt] == 0) {
+	registers[LoReg] = 0;
+	registers[HiReg] = 0;
+    } else {
+	registers[LoReg] =  registers[instr->rs] / registers[instr->rt];
+	registers[HiReg] = registers[instr->rs] % registers[instr->rt];
+    }
+    NEXT_INSTRUCTION;
+
+  op_divu:
+    rs = (unsigned int) registers[instr->rs];
+    rt = (unsigned int) registers[instr->rt];
+    if (rt == 0) {
+	registers[LoReg] = 0;
+	registers[HiReg] = 0;
+    } else {
+	tmp = rs / rt;
+	registers[LoReg] = (int) tmp;
+	tmp = rs % rt;
+	registers[HiReg] = (int) tmp;
+    }
+    NEXT_INSTRUCTION;
+
+  op_jal:
+    registers[R31] = registers[NextPCReg] + 4;
+  op_j:
+    pcAfter = (pcAfter & 0xf0000000) | IndexToAddr(instr->extra);
+    NEXT_INSTRUCTION;
+
+  op_jalr:
+    registers[instr->rd] = registers[NextPCReg] + 4;
+  op_jr:
+    pcAfter = registers[instr->rs];
+    NEXT_INSTRUCTION;
+
+  op_lb:				// also OP_LBU
+    tmp = registers[instr->rs] + instr->extra;
+    if (!ReadMem<Trace, UseTLB>(tmp, 1, &value))
+	goto trapped;
+    if ((value & 0x80) && (instr->opCode == OP_LB))
+	value |= 0xffffff00;
+    else
+	value &= 0xff;
+    nextLoadReg = instr->rt;
+    nextLoadValue = value;
+    NEXT_INSTRUCTION;
+
+  op_lh:				// also OP_LHU
+    tmp = registers[instr->rs] + instr->extra;
+    if (tmp & 0x1) {
+	RaiseException(AddressErrorException, tmp);
+	goto trapped;
+    }
+    if (!ReadMem<Trace, UseTLB>(tmp, 2, &value))
+	goto trapped;
+    if ((value & 0x8000) && (instr->opCode == OP_LH))
+	value |= 0xffff0000;
+    else
+	value &= 0xffff;
+    nextLoadReg = instr->rt;
+    nextLoadValue = value;
+    NEXT_INSTRUCTION;
+
+  op_lui:
+    if (Trace)
+	DEBUG('m', "Executing: LUI r%d,%d\n", instr->rt, instr->extra);
+    registers[instr->rt] = instr->extra << 16;
+    NEXT_INSTRUCTION;
+
+  op_lw:
+    tmp = registers[instr->rs] + instr->extra;
+    if (tmp & 0x3) {
+	RaiseException(AddressErrorException, tmp);
+	goto trapped;
+    }
+    if (!ReadMem<Trace, UseTLB>(tmp, 4, &value))
+	goto trapped;
+    nextLoadReg = instr->rt;
+    nextLoadValue = value;
+    NEXT_INSTRUCTION;
+
+  op_lwl:
+    tmp = registers[instr->rs] + instr->extra;
+    ASSERT((tmp & 0x3) == 0);		// see OneInstruction
+    if (!ReadMem<Trace, UseTLB>(tmp, 4, &value))
+	goto trapped;
+    if (registers[LoadReg] == instr->rt)
+	nextLoadValue = registers[LoadValueReg];
+    else
+	nextLoadValue = registers[instr->rt];
+    switch (tmp & 0x3) {
+      case 0:
+	nextLoadValue = value;
+	break;
+      case 1:
+	nextLoadValue = (nextLoadValue & 0xff) | (value << 8);
+	break;
+      case 2:
+	nextLoadValue = (nextLoadValue & 0xffff) | (value << 16);
+	break;
+      case 3:
+	nextLoadValue = (nextLoadValue & 0xffffff) | (value << 24);
+	break;
+    }
+    nextLoadReg = instr->rt;
+    NEXT_INSTRUCTION;
+
+  op_lwr:
+    tmp = registers[instr->rs] + instr->extra;
+    ASSERT((tmp & 0x3) == 0);		// see OneInstruction
+    if (!ReadMem<Trace, UseTLB>(tmp, 4, &value))
+	goto trapped;
+    if (registers[LoadReg] == instr->rt)
+	nextLoadValue = registers[LoadValueReg];
+    else
+	nextLoadValue = registers[instr->rt];
+    switch (tmp & 0x3) {
+      case 0:
+	nextLoadValue = (nextLoadValue & 0xffffff00) |
+	    ((value >> 24) & 0xff);
+	break;
+      case 1:
+	nextLoadValue = (nextLoadValue & 0xffff0000) |
+	    ((value >> 16) & 0xffff);
+	break;
+      case 2:
+	nextLoadValue = (nextLoadValue & 0xff000000)
+	    | ((value >> 8) & 0xffffff);
+	break;
+      case 3:
+	nextLoadValue = value;
+	break;
+    }
+    nextLoadReg = instr->rt;
+    NEXT_INSTRUCTION;
+
+  op_mfhi:
+    registers[instr->rd] = registers[HiReg];
+    NEXT_INSTRUCTION;
+
+  op_mflo:
+    registers[instr->rd] = registers[LoReg];
+    NEXT_INSTRUCTION;
+
+  op_mthi:
+    registers[HiReg] = registers[instr->rs];
+    NEXT_INSTRUCTION;
+
+  op_mtlo:
+    registers[LoReg] = registers[instr->rs];
+    NEXT_INSTRUCTION;
+
+  op_mult:
+    Mult(registers[instr->rs], registers[instr->rt], TRUE,
+	 &registers[HiReg], &registers[LoReg]);
+    NEXT_INSTRUCTION;
+
+  op_multu:
+    Mult(registers[instr->rs], registers[instr->rt], FALSE,
+	 &registers[HiReg], &registers[LoReg]);
+    NEXT_INSTRUCTION;
+
+  op_nor:
+    registers[instr->rd] = ~(registers[instr->rs] | registers[instr->rt]);
+    NEXT_INSTRUCTION;
+
+  op_or:				// same (rs | rs) as OneInstruction
+    registers[instr->rd] = registers[instr->rs] | registers[instr->rs];
+    NEXT_INSTRUCTION;
+
+  op_ori:
+    registers[instr->rt] = registers[instr->rs] | (instr->extra & 0xffff);
+    NEXT_INSTRUCTION;
+
+  op_sb:
+    if (!WriteMem<Trace, UseTLB>((unsigned) 
+	    (registers[instr->rs] + instr->extra), 1, registers[instr->rt]))
+	goto trapped;
+    NEXT_INSTRUCTION;
+
+  op_sh:
+    if (!WriteMem<Trace, UseTLB>((unsigned) 
+	    (registers[instr->rs] + instr->extra), 2, registers[instr->rt]))
+	goto trapped;
+    NEXT_INSTRUCTION;
+
+  op_sll:
+    registers[instr->rd] = registers[instr->rt] << instr->extra;
+    NEXT_INSTRUCTION;
+
+  op_sllv:
+    registers[instr->rd] = registers[instr->rt] <<
+	(registers[instr->rs] & 0x1f);
+    NEXT_INSTRUCTION;
+
+  op_slt:
+    if (registers[instr->rs] < registers[instr->rt])
+	registers[instr->rd] = 1;
+    else
+	registers[instr->rd] = 0;
+    NEXT_INSTRUCTION;
+
+  op_slti:
+    if (registers[instr->rs] < instr->extra)
+	registers[instr->rt] = 1;
+    else
+	registers[instr->rt] = 0;
+    NEXT_INSTRUCTION;
+
+  op_sltiu:
+    rs = registers[instr->rs];
+    imm = instr->extra;
+    if (rs < imm)
+	registers[instr->rt] = 1;
+    else
+	registers[instr->rt] = 0;
+    NEXT_INSTRUCTION;
+
+  op_sltu:
+    rs = registers[instr->rs];
+    rt = registers[instr->rt];
+    if (rs < rt)
+	registers[instr->rd] = 1;
+    else
+	registers[instr->rd] = 0;
+    NEXT_INSTRUCTION;
+
+  op_sra:
+    registers[instr->rd] = registers[instr->rt] >> instr->extra;
+    NEXT_INSTRUCTION;
+
+  op_srav:
+    registers[instr->rd] = registers[instr->rt] >>
+	(registers[instr->rs] & 0x1f);
+    NEXT_INSTRUCTION;
+
+  op_srl:
+    tmp = registers[instr->rt];
+    tmp >>= instr->extra;
+    registers[instr->rd] = tmp;
+    NEXT_INSTRUCTION;
+
+  op_srlv:
+    tmp = registers[instr->rt];
+    tmp >>= (registers[instr->rs] & 0x1f);
+    registers[instr->rd] = tmp;
+    NEXT_INSTRUCTION;
+
+  op_sub:
+    diff = registers[instr->rs] - registers[instr->rt];
+    if (((registers[instr->rs] ^ registers[instr->rt]) & SIGN_BIT) &&
+	((registers[instr->rs] ^ diff) & SIGN_BIT)) {
+	RaiseException(OverflowException, 0);
+	goto trapped;
+    }
+    registers[instr->rd] = diff;
+    NEXT_INSTRUCTION;
+
+  op_subu:
+    registers[instr->rd] = registers[instr->rs] - registers[instr->rt];
+    NEXT_INSTRUCTION;
+
+  op_sw:
+    if (!WriteMem<Trace, UseTLB>((unsigned) 
+	    (registers[instr->rs] + instr->extra), 4, registers[instr->rt]))
+	goto trapped;
+    NEXT_INSTRUCTION;
+
+  op_swl:
+    tmp = registers[instr->rs] + instr->extra;
+    ASSERT((tmp & 0x3) == 0);		// see OneInstruction
+    if (!ReadMem<Trace, UseTLB>((tmp & ~0x3), 4, &value))
+	goto trapped;
+    switch (tmp & 0x3) {
+      case 0:
+	value = registers[instr->rt];
+	break;
+      case 1:
+	value = (value & 0xff000000) | ((registers[instr->rt] >> 8) &
+					0xffffff);
+	break;
+      case 2:
+	value = (value & 0xffff0000) | ((registers[instr->rt] >> 16) &
+					0xffff);
+	break;
+      case 3:
+	value = (value & 0xffffff00) | ((registers[instr->rt] >> 24) &
+					0xff);
+	break;
+    }
+    if (!WriteMem<Trace, UseTLB>((tmp & ~0x3), 4, value))
+	goto trapped;
+    NEXT_INSTRUCTION;
+
+  op_swr:
+    tmp = registers[instr->rs] + instr->extra;
+    ASSERT((tmp & 0x3) == 0);		// see OneInstruction
+    if (!ReadMem<Trace, UseTLB>((tmp & ~0x3), 4, &value))
+	goto trapped;
+    switch (tmp & 0x3) {
+      case 0:
+	value = (value & 0xffffff) | (registers[instr->rt] << 24);
+	break;
+      case 1:
+	value = (value & 0xffff) | (registers[instr->rt] << 16);
+	break;
+      case 2:
+	value = (value & 0xff) | (registers[instr->rt] << 8);
+	break;
+      case 3:
+	value = registers[instr->rt];
+	break;
+    }
+    if (!WriteMem<Trace, UseTLB>((tmp & ~0x3), 4, value))
+	goto trapped;
+    NEXT_INSTRUCTION;
+
+  op_syscall:
+    RaiseException(SyscallException, 0);
+    goto trapped;
+
+  op_xor:
+    registers[instr->rd] = registers[instr->rs] ^ registers[instr->rt];
+    NEXT_INSTRUCTION;
+
+  op_xori:
+    registers[instr->rt] = registers[instr->rs] ^ (instr->extra & 0xffff);
+    NEXT_INSTRUCTION;
+
+  op_illegal:				// OP_RES and OP_UNIMP
+    RaiseException(IllegalInstrException, 0);
+    goto trapped;
+
+  op_bad:
+    ASSERT(FALSE);
+    goto trapped;
 }
 
+#undef TICK
+#undef FETCH_AND_DISPATCH
+#undef NEXT_INSTRUCTION
+#endif // THREADED_DISPATCH
+
 //----------------------------------------------------------------------
 // Machine::DelayedLoad
 // 	Simulate effects of a delayed load.
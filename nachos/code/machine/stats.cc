@@ -37,6 +37,22 @@ Statistics::Statistics()
 
     totalPageFaults = 0;  
     sharedPageFaults = 0;
+
+    numTLBHits = numTLBMisses = 0;
+    numICacheHits = numICacheMisses = numDCacheHits = numDCacheMisses = 0;
+    cacheStallTicks = 0;
+    numTimerInterrupts = 0;
+    cfsDispatches = cfsMaxSpread = cfsShareThreads = 0;
+    cfsSpreadTotal = cfsMinShare = cfsMaxShare = 0;
+    mlfqDemotions = mlfqPromotions = mlfqBoosts = 0;
+    strideLoans = srtfPreemptions = 0;
+    quantumAdjustments = minQuantum = maxQuantum = lastQuantum = 0;
+    rtAdmitted = rtRejected = rtJobs = rtDeadlineMisses = 0;
+    rtOverruns = rtPreemptions = 0;
+
+    numCPUs = 1;
+    for (int i = 0; i < MaxCPUs; i++)
+	cpuBusyTicks[i] = 0;
 }
 
 //----------------------------------------------------------------------
@@ -58,6 +74,7 @@ Statistics::Print()
     printf("Paging: faults %d\n", numPageFaults);
     printf("Network I/O: packets received %d, sent %d\n", numPacketsRecvd, 
 	numPacketsSent);
+    printf("Timer interrupts: %d\n", numTimerInterrupts);
 
     printf("\nTotal simulated ticks: %d\n", totalTicks - start_time);
     printf("Total CPU busy time: %d\n", cpu_time);
@@ -67,4 +84,43 @@ Statistics::Print()
     printf("Wait time in ready queue: Total: %d, Average: %.2f\n\n", total_wait_time, (float)total_wait_time/numTotalThreads);
     printf("Total number of shared page faults is : %d\n", sharedPageFaults);
     printf("The total number of page faults is: %d\n",totalPageFaults);
+    if (numTLBHits + numTLBMisses > 0)
+	printf("TLB: hits %d, misses %d, hit ratio %.2f%%\n", numTLBHits,
+	    numTLBMisses, 100.0*numTLBHits/(numTLBHits + numTLBMisses));
+    if (numICacheHits + numICacheMisses > 0)
+	printf("L1 I-cache: hits %d, misses %d, hit ratio %.2f%%\n",
+	    numICacheHits, numICacheMisses,
+	    100.0*numICacheHits/(numICacheHits + numICacheMisses));
+    if (numDCacheHits + numDCacheMisses > 0)
+	printf("L1 D-cache: hits %d, misses %d, hit ratio %.2f%%\n",
+	    numDCacheHits, numDCacheMisses,
+	    100.0*numDCacheHits/(numDCacheHits + numDCacheMisses));
+    if (cacheStallTicks > 0)
+	printf("Cache miss stall time: %d\n", cacheStallTicks);
+    if (cfsDispatches > 0)
+	printf("Virtual runtime spread at dispatch: max %d, mean %.2f\n",
+	    cfsMaxSpread, cfsSpreadTotal/cfsDispatches);
+    if (cfsShareThreads > 0)
+	printf("CPU share per unit weight: min %.4f, max %.4f, spread %.2f\n",
+	    cfsMinShare, cfsMaxShare, cfsMaxShare/cfsMinShare);
+    if (rtAdmitted + rtRejected > 0) {
+	printf("Real-time: reservations %d, refused %d, preemptions %d\n",
+	    rtAdmitted, rtRejected, rtPreemptions);
+	printf("Real-time jobs: %d, deadline misses %d, budget overruns %d\n",
+	    rtJobs, rtDeadlineMisses, rtOverruns);
+    }
+    if (srtfPreemptions > 0)
+	printf("SRTF: preemptions %d\n", srtfPreemptions);
+    if (strideLoans > 0)
+	printf("Stride scheduling: ticket loans %d\n", strideLoans);
+    if (mlfqDemotions + mlfqPromotions + mlfqBoosts > 0)
+	printf("MLFQ: demotions %d, promotions %d, boosts %d\n",
+	    mlfqDemotions, mlfqPromotions, mlfqBoosts);
+    if (quantumAdjustments > 0)
+	printf("Adaptive quantum: adjustments %d, min %d, max %d, final %d\n",
+	    quantumAdjustments, minQuantum, maxQuantum, lastQuantum);
+    if (numCPUs > 1)
+	for (int i = 0; i < numCPUs; i++)
+	    printf("CPU %d: busy %d ticks, utilization %.2f%%\n", i,
+		cpuBusyTicks[i], 100.0*cpuBusyTicks[i]/(userTicks ? userTicks : 1));
 }
@@ -13,6 +13,8 @@
 
 #include "copyright.h"
 
+#define MaxCPUs		16	// most CPUs the machine can be configured with
+
 // The following class defines the statistics that are to be kept
 // about Nachos behavior -- how much time (ticks) elapsed, how
 // many user instructions executed, etc.
@@ -53,6 +55,38 @@ class Statistics {
 
     int sharedPageFaults;
     int totalPageFaults;    // added by prince, denotes number of total page faults 
+    int numTLBHits;		// translations found in the TLB
+    int numTLBMisses;		// translations missing from the TLB
+    int numICacheHits;		// instruction fetches that hit the L1 I-cache
+    int numICacheMisses;	// instruction fetches that missed it
+    int numDCacheHits;		// loads and stores that hit the L1 D-cache
+    int numDCacheMisses;	// loads and stores that missed it
+    int cacheStallTicks;	// user time charged for cache misses
+    int numTimerInterrupts;	// number of interrupts from the timer
+    int cfsDispatches;		// CFS (or stride scheduling): dispatches
+				// from the ready tree
+    int cfsMaxSpread;		// CFS: largest spread of virtual runtimes
+    double cfsSpreadTotal;	// in the ready tree at a dispatch, and sum
+    int cfsShareThreads;	// CFS: least and largest CPU share per unit
+    double cfsMinShare, cfsMaxShare;	// weight, of the exited threads
+    int rtAdmitted, rtRejected;	// Real-time reservations made and refused
+    int rtJobs;			// Real-time jobs (periods) done, and how
+    int rtDeadlineMisses;	// many of them were done late
+    int rtOverruns;		// Jobs that used up their budget
+    int rtPreemptions;		// Threads preempted by a real-time thread
+    int srtfPreemptions;	// SRTF: running threads preempted by a
+				// thread with a shorter estimate
+    int strideLoans;		// Stride: tickets lent by joining threads
+    int mlfqDemotions;		// MLFQ: moves down a queue, on using up a
+				// time slice
+    int mlfqPromotions;		// MLFQ: moves up a queue, on waking up
+    int mlfqBoosts;		// MLFQ: moves of everyone to the top queue
+    int quantumAdjustments;	// Changes of the adaptive quantum, the
+    int minQuantum, maxQuantum;	// range it took, and what it ended at
+    int lastQuantum;
+    int numCPUs;		// number of simulated CPUs
+    int cpuBusyTicks[MaxCPUs];	// user ticks each CPU had a thread to run
+				// (only kept if there are several CPUs)
     Statistics(); 		// initialize everything to zero
 
     void Print();		// print collected statistics
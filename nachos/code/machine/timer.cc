@@ -39,16 +39,21 @@ static void TimerHandler(int arg)
 //      "callArg" is the parameter to be passed to the interrupt handler.
 //      "doRandom" -- if true, arrange for the interrupts to occur
 //		at random, instead of fixed, intervals.
+//      "doOneShot" -- if true, only the first interrupt comes by itself;
+//		after that, the interrupts come when SetAlarm asks for them.
 //----------------------------------------------------------------------
 
-Timer::Timer(VoidFunctionPtr timerHandler, int callArg, bool doRandom)
+Timer::Timer(VoidFunctionPtr timerHandler, int callArg, bool doRandom,
+	     bool doOneShot)
 {
     randomize = doRandom;
+    oneShot = doOneShot;
     handler = timerHandler;
     arg = callArg; 
 
     // schedule the first interrupt from the timer device
-    interrupt->Schedule(TimerHandler, (int) this, TimeOfNextInterrupt(), 
+    alarm = stats->totalTicks + TimeOfNextInterrupt();
+    interrupt->Schedule(TimerHandler, (int) this, alarm - stats->totalTicks, 
 		TimerInt); 
 }
 
@@ -61,14 +66,43 @@ Timer::Timer(VoidFunctionPtr timerHandler, int callArg, bool doRandom)
 void 
 Timer::TimerExpired() 
 {
-    // schedule the next timer device interrupt
-    interrupt->Schedule(TimerHandler, (int) this, TimeOfNextInterrupt(), 
+    stats->numTimerInterrupts++;
+
+    // schedule the next timer device interrupt, unless we wait to be asked
+    if (oneShot)
+	alarm = -1;
+    else
+	interrupt->Schedule(TimerHandler, (int) this, TimeOfNextInterrupt(), 
 		TimerInt);
 
     // invoke the Nachos interrupt handler for this device
     (*handler)(arg);
 }
 
+//----------------------------------------------------------------------
+// Timer::SetAlarm
+//      In one-shot mode, arrange for the next interrupt to come at time
+//	"when" (at the next tick, if that has already passed), replacing
+//	the one asked for before, if any.  If "when" is -1, there is to
+//	be no interrupt until the next SetAlarm.
+//----------------------------------------------------------------------
+
+void
+Timer::SetAlarm(int when)
+{
+    ASSERT(oneShot);
+    if ((when != -1) && (when <= stats->totalTicks))
+	when = stats->totalTicks + 1;
+    if (when == alarm)			// already set for then
+	return;
+    if (alarm != -1)
+	interrupt->Unschedule(TimerHandler, (int) this);
+    alarm = when;
+    if (alarm != -1)
+	interrupt->Schedule(TimerHandler, (int) this, 
+		alarm - stats->totalTicks, TimerInt);
+}
+
 //----------------------------------------------------------------------
 // Timer::TimeOfNextInterrupt
 //      Return when the hardware timer device will next cause an interrupt.
@@ -11,6 +11,11 @@
 //	In order to introduce some randomness into time-slicing, if "doRandom"
 //	is set, then the interrupt comes after a random number of ticks.
 //
+//	The timer can instead be run in one-shot mode, where after the first
+//	interrupt it only interrupts when the kernel asks for it, at the
+//	time it asks for (see SetAlarm).  This lets the kernel take an
+//	interrupt only when it has something to do (a "tickless" kernel).
+//
 //  DO NOT CHANGE -- part of the machine emulation
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
@@ -26,11 +31,18 @@
 // The following class defines a hardware timer. 
 class Timer {
   public:
-    Timer(VoidFunctionPtr timerHandler, int callArg, bool doRandom);
+    Timer(VoidFunctionPtr timerHandler, int callArg, bool doRandom,
+	  bool doOneShot);
 				// Initialize the timer, to call the interrupt
-				// handler "timerHandler" every time slice.
+				// handler "timerHandler" every time slice
+				// (or, one-shot, when asked to).
     ~Timer() {}
 
+    bool IsPeriodic() { return !oneShot; }
+    void SetAlarm(int when);	// One-shot mode: interrupt at time "when"
+				// (or never, if "when" is -1), instead of
+				// whenever was asked for before
+
 // Internal routines to the timer emulation -- DO NOT call these
 
     void TimerExpired();	// called internally when the hardware
@@ -41,6 +53,9 @@ class Timer {
 
   private:
     bool randomize;		// set if we need to use a random timeout delay
+    bool oneShot;		// set if we only interrupt when asked to
+    int alarm;			// one-shot mode: when the interrupt asked
+				// for is due, -1 if none is
     VoidFunctionPtr handler;	// timer interrupt handler 
     int arg;			// argument to pass to interrupt handler
 
@@ -82,8 +82,24 @@ ShortToMachine(unsigned short shortword) { return ShortToHost(shortword); }
 //	"addr" -- the virtual address to read from
 //	"size" -- the number of bytes to read (1, 2, or 4)
 //	"value" -- the place to write the result
+//
+//	This is the kernel's version; the simulator calls the variant
+//	it was compiled for (see Machine::Run).
 //----------------------------------------------------------------------
 
+bool
+Machine::ReadMem(int addr, int size, int *value)
+{
+    bool trace = DebugIsEnabled('a');
+
+    if (tlb == NULL)
+	return trace ? ReadMem<true, false>(addr, size, value)
+		     : ReadMem<false, false>(addr, size, value);
+    return trace ? ReadMem<true, true>(addr, size, value)
+		 : ReadMem<false, true>(addr, size, value);
+}
+
+template <bool Trace, bool UseTLB>
 bool
 Machine::ReadMem(int addr, int size, int *value)
 {
@@ -91,13 +107,20 @@ Machine::ReadMem(int addr, int size, int *value)
     ExceptionType exception;
     int physicalAddress;
     
-    DEBUG('a', "Reading VA 0x%x, size %d\n", addr, size);
+    if (Trace)
+	DEBUG('a', "Reading VA 0x%x, size %d\n", addr, size);
     
-    exception = Translate(addr, &physicalAddress, size, FALSE);
+    exception = CachedTranslate<Trace, UseTLB>(addr, &physicalAddress, size, FALSE);
     if (exception != NoException) {
     	machine->RaiseException(exception, addr);
     	return FALSE;
     }
+    if (Trace && (interrupt->getStatus() == UserMode)) {
+	if (profiler != NULL)
+	    profiler->CountAccess(addr, FALSE);
+	if (dcache != NULL)
+	    CacheAccess(dcache, physicalAddress);
+    }
     switch (size) {
       case 1:
 	data = machine->mainMemory[physicalAddress];
@@ -117,7 +140,8 @@ Machine::ReadMem(int addr, int size, int *value)
       default: ASSERT(FALSE);
     }
     
-    DEBUG('a', "\tvalue read = %8.8x\n", *value);
+    if (Trace)
+	DEBUG('a', "\tvalue read = %8.8x\n", *value);
     physpage_LRU[physicalAddress/PageSize] = stats->totalTicks;
     physpage_LRUclock[physicalAddress/PageSize] = 1;
     return (TRUE);
@@ -134,21 +158,44 @@ Machine::ReadMem(int addr, int size, int *value)
 //	"addr" -- the virtual address to write to
 //	"size" -- the number of bytes to be written (1, 2, or 4)
 //	"value" -- the data to be written
+//
+//	As for ReadMem, this is the kernel's version.
 //----------------------------------------------------------------------
 
+bool
+Machine::WriteMem(int addr, int size, int value)
+{
+    bool trace = DebugIsEnabled('a');
+
+    if (tlb == NULL)
+	return trace ? WriteMem<true, false>(addr, size, value)
+		     : WriteMem<false, false>(addr, size, value);
+    return trace ? WriteMem<true, true>(addr, size, value)
+		 : WriteMem<false, true>(addr, size, value);
+}
+
+template <bool Trace, bool UseTLB>
 bool
 Machine::WriteMem(int addr, int size, int value)
 {
     ExceptionType exception;
     int physicalAddress;
+    Instruction *decoded;
      
-    DEBUG('a', "Writing VA 0x%x, size %d, value 0x%x\n", addr, size, value);
+    if (Trace)
+	DEBUG('a', "Writing VA 0x%x, size %d, value 0x%x\n", addr, size, value);
 
-    exception = Translate(addr, &physicalAddress, size, TRUE);
+    exception = CachedTranslate<Trace, UseTLB>(addr, &physicalAddress, size, TRUE);
     if (exception != NoException) {
 	machine->RaiseException(exception, addr);
 	return FALSE;
     }
+    if (Trace && (interrupt->getStatus() == UserMode)) {
+	if (profiler != NULL)
+	    profiler->CountAccess(addr, TRUE);
+	if (dcache != NULL)
+	    CacheAccess(dcache, physicalAddress);
+    }
     switch (size) {
       case 1:
 	machine->mainMemory[physicalAddress] = (unsigned char) (value & 0xff);
@@ -166,11 +213,249 @@ Machine::WriteMem(int addr, int size, int value)
 	
       default: ASSERT(FALSE);
     }
+    decoded = decodedPages[physicalAddress/PageSize];
+    if ((decoded != NULL) &&			// self-modifying code
+	(decoded[(physicalAddress % PageSize) >> 2].opCode != 0)) {
+	decoded[(physicalAddress % PageSize) >> 2].opCode = 0;
+	for (int i = 0; i < PageSize/4; i++)	// re-carve the page's blocks
+	    blockLengths[physicalAddress/PageSize][i] = 0;
+	blockEpoch++;
+    }
     physpage_LRU[physicalAddress/PageSize] = stats->totalTicks;
     physpage_LRUclock[physicalAddress/PageSize] = 1;
     return TRUE;
 }
 
+//----------------------------------------------------------------------
+// Machine::FetchInstruction
+//      Fetch the instruction at virtual address "addr" into "instr",
+//	already decoded.
+//
+//	The translation is done on every fetch, exactly as ReadMem would
+//	do it, so that page faults and the use bits and LRU information
+//	of the page are unchanged.  Only the memory read and the call to
+//	Instruction::Decode are skipped, once the word has been decoded
+//	since its physical page was last loaded or written.
+//
+//   	Returns FALSE if the translation step from virtual to physical memory
+//   	failed.
+//
+//	"addr" -- the virtual address of the instruction
+//	"instr" -- the place to store the decoded instruction
+//----------------------------------------------------------------------
+
+template <bool Trace, bool UseTLB>
+bool
+Machine::FetchInstruction(int addr, Instruction *instr)
+{
+    ExceptionType exception;
+    int physicalAddress;
+    Instruction *decoded;
+
+    exception = CachedTranslate<Trace, UseTLB>(addr, &physicalAddress, 4, FALSE);
+    if (exception != NoException) {
+	RaiseException(exception, addr);
+	return FALSE;
+    }
+    if (Trace && (icache != NULL))
+	CacheAccess(icache, physicalAddress);
+
+    decoded = DecodedPage(physicalAddress/PageSize)
+		+ ((physicalAddress % PageSize) >> 2);
+    if (decoded->opCode == 0) {		// not decoded yet
+	decoded->value = 
+		WordToHost(*(unsigned int *) &mainMemory[physicalAddress]);
+	decoded->Decode();
+    }
+    *instr = *decoded;
+
+    physpage_LRU[physicalAddress/PageSize] = stats->totalTicks;
+    physpage_LRUclock[physicalAddress/PageSize] = 1;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Machine::InvalidateDecodedPage
+//      Throw away the decoded instructions cached for a physical page,
+//	and the page's lines in the I and D caches, if they are modelled.
+//	The kernel must call this whenever it changes the contents of
+//	a page behind the simulator's back (loading a program, copying
+//	pages on fork, bringing a page in on a fault, or handing the
+//	frame to someone else).  Stores done by user programs go through
+//	WriteMem, which takes care of itself.
+//
+//	"physPage" -- the physical page number
+//----------------------------------------------------------------------
+
+void
+Machine::InvalidateDecodedPage(int physPage)
+{
+    ASSERT((physPage >= 0) && (physPage < NumPhysPages));
+    if (icache != NULL)
+	icache->InvalidatePage(physPage);
+    if (dcache != NULL)
+	dcache->InvalidatePage(physPage);
+    if (decodedPages[physPage] != NULL) {
+	delete [] decodedPages[physPage];
+	delete [] blockLengths[physPage];
+	decodedPages[physPage] = NULL;
+	blockLengths[physPage] = NULL;
+	blockEpoch++;
+    }
+}
+
+//----------------------------------------------------------------------
+// Machine::CacheAccess
+//      Model a user instruction fetch (through "icache") or load or 
+//	store (through "dcache") at physical address "physAddr", by the
+//	current process.  A miss stalls the CPU for cacheMissPenalty ticks
+//	of user time.
+//----------------------------------------------------------------------
+
+void
+Machine::CacheAccess(Cache *cache, int physAddr)
+{
+    if (cache->Access(physAddr, currentThread->GetPID())) {
+	if (cache == icache)
+	    stats->numICacheHits++;
+	else
+	    stats->numDCacheHits++;
+	return;
+    }
+    if (cache == icache)
+	stats->numICacheMisses++;
+    else
+	stats->numDCacheMisses++;
+    stats->totalTicks += cacheMissPenalty;
+    stats->userTicks += cacheMissPenalty;
+    stats->cacheStallTicks += cacheMissPenalty;
+}
+
+//----------------------------------------------------------------------
+// Machine::DecodedPage
+//      Return the array of decoded instructions for a physical page,
+//	allocating it (with nothing decoded yet) if the page has not
+//	been executed from since it was last loaded.
+//
+//	"physPage" -- the physical page number
+//----------------------------------------------------------------------
+
+Instruction *
+Machine::DecodedPage(int physPage)
+{
+    if (decodedPages[physPage] == NULL) {
+	decodedPages[physPage] = new Instruction[PageSize/4];
+	blockLengths[physPage] = new unsigned short[PageSize/4];
+	for (int i = 0; i < PageSize/4; i++) {
+	    decodedPages[physPage][i].opCode = 0;
+	    blockLengths[physPage][i] = 0;
+	}
+    }
+    return decodedPages[physPage];
+}
+
+//----------------------------------------------------------------------
+// Machine::FetchBlock
+//      Translate the virtual address "addr" of an instruction, and
+//	return the basic block that starts there (see CarveBlock).
+//
+//	The translation is done exactly as FetchInstruction would do it
+//	for the first instruction of the block; RunBlocks keeps the use
+//	and LRU information right for the rest.
+//
+//   	Returns NULL if the translation step from virtual to physical memory
+//   	failed.
+//
+//	"addr" -- the virtual address of the first instruction
+//	"length" -- the place to store the number of instructions
+//	"physPage" -- the place to store the physical page of the block
+//----------------------------------------------------------------------
+
+template <bool Trace, bool UseTLB>
+Instruction *
+Machine::FetchBlock(int addr, int *length, int *physPage)
+{
+    ExceptionType exception;
+    int physicalAddress;
+
+    exception = CachedTranslate<Trace, UseTLB>(addr, &physicalAddress, 4, FALSE);
+    if (exception != NoException) {
+	RaiseException(exception, addr);
+	return NULL;
+    }
+    *physPage = physicalAddress / PageSize;
+    physpage_LRU[physicalAddress/PageSize] = stats->totalTicks;
+    physpage_LRUclock[physicalAddress/PageSize] = 1;
+    return CarveBlock(physicalAddress, length);
+}
+
+//----------------------------------------------------------------------
+// Machine::CachedTranslate
+// 	Translate a virtual address into a physical address, exactly as
+//	Translate does, but look in the soft TLB first.
+//
+//	A hit skips all of Translate, except for setting the use bit
+//	(and the dirty bit, on a store) of the page table entry, so the
+//	page replacement code still sees the same reference information.
+//	A page is only entered as writable once a store to it has gone
+//	through Translate, which checks the read-only bit and marks the
+//	page dirty.  Misses go to Translate, and fill the soft TLB if it
+//	succeeds.  With a real TLB, the soft TLB is left out altogether.
+//
+//	"virtAddr" -- the virtual address to translate
+//	"physAddr" -- the place to store the physical address
+//	"size" -- the amount of memory being read or written
+// 	"writing" -- if TRUE, the page must be writable
+//----------------------------------------------------------------------
+
+template <bool Trace, bool UseTLB>
+ExceptionType
+Machine::CachedTranslate(int virtAddr, int* physAddr, int size, bool writing)
+{
+    unsigned int vpn = (unsigned) virtAddr / PageSize;
+    SoftTLBEntry *cached = &softTLB[vpn & (SoftTLBSize - 1)];
+    ExceptionType exception;
+
+    if (UseTLB)
+	return Translate<Trace, UseTLB>(virtAddr, physAddr, size, writing);
+    if ((cached->virtualPage == (int) vpn) && ((virtAddr & (size - 1)) == 0)
+					&& (cached->writable || !writing)) {
+	cached->entry->use = TRUE;
+	if (writing)
+	    cached->entry->dirty = TRUE;
+	*physAddr = cached->physicalPage * PageSize 
+				+ (unsigned) virtAddr % PageSize;
+	return NoException;
+    }
+
+    exception = Translate<Trace, UseTLB>(virtAddr, physAddr, size, writing);
+    if ((exception == NoException) && useSoftTLB) {
+	if (cached->virtualPage != (int) vpn)
+	    cached->writable = FALSE;
+	cached->virtualPage = vpn;
+	cached->physicalPage = *physAddr / PageSize;
+	cached->entry = &KernelPageTable[vpn];
+	if (writing)
+	    cached->writable = TRUE;
+    }
+    return exception;
+}
+
+//----------------------------------------------------------------------
+// Machine::FlushSoftTLB
+// 	Throw away all the translations in the soft TLB.  Must be called
+//	whenever the page table changes: when switching to another
+//	address space, when a page is evicted, or when the page table is
+//	replaced or freed.
+//----------------------------------------------------------------------
+
+void
+Machine::FlushSoftTLB()
+{
+    for (int i = 0; i < SoftTLBSize; i++)
+	softTLB[i].virtualPage = -1;
+}
+
 //----------------------------------------------------------------------
 // Machine::Translate
 // 	Translate a virtual address into a physical address, using 
@@ -184,60 +469,86 @@ Machine::WriteMem(int addr, int size, int value)
 //	"physAddr" -- the place to store the physical address
 //	"size" -- the amount of memory being read or written
 // 	"writing" -- if TRUE, check the "read-only" bit in the TLB
+//
+//	As for ReadMem, the simulator calls the variant it was compiled
+//	for (see Machine::Run); this version picks one.
 //----------------------------------------------------------------------
 
 ExceptionType
 Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
 {
-    int i;
+    bool trace = DebugIsEnabled('a');
+
+    if (tlb == NULL)
+	return trace ? Translate<true, false>(virtAddr, physAddr, size, writing)
+		     : Translate<false, false>(virtAddr, physAddr, size, writing);
+    return trace ? Translate<true, true>(virtAddr, physAddr, size, writing)
+		 : Translate<false, true>(virtAddr, physAddr, size, writing);
+}
+
+template <bool Trace, bool UseTLB>
+ExceptionType
+Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
+{
+    int i, first;
     unsigned int vpn, offset;
     TranslationEntry *entry;
     unsigned int pageFrame;
 
-    DEBUG('a', "\tTranslate 0x%x, %s: ", virtAddr, writing ? "write" : "read");
+    if (Trace)
+	DEBUG('a', "\tTranslate 0x%x, %s: ", virtAddr, writing ? "write" : "read");
 
 // check for alignment errors
     if (((size == 4) && (virtAddr & 0x3)) || ((size == 2) && (virtAddr & 0x1))){
-	DEBUG('a', "alignment problem at %d, size %d!\n", virtAddr, size);
+	if (Trace)
+	    DEBUG('a', "alignment problem at %d, size %d!\n", virtAddr, size);
 	return AddressErrorException;
     }
     
-    // we must have either a TLB or a page table, but not both!
-    ASSERT(tlb == NULL || KernelPageTable == NULL);	
-    ASSERT(tlb != NULL || KernelPageTable != NULL);	
+    // we must have either a TLB or a page table; if we have both, the
+    // page table is only there for the kernel
+    ASSERT(UseTLB ? (tlb != NULL) : (KernelPageTable != NULL));
 
 // calculate the virtual page number, and offset within the page,
 // from the virtual address
     vpn = (unsigned) virtAddr / PageSize;
     offset = (unsigned) virtAddr % PageSize;
     
-    if (tlb == NULL) {		// => page table => vpn is index into table
+    if (!UseTLB) {		// => page table => vpn is index into table
 	if (vpn >= KernelPageTableSize) {
-	    DEBUG('a', "virtual page # %d too large for page table size %d!\n", 
+	    if (Trace)
+		DEBUG('a', "virtual page # %d too large for page table size %d!\n", 
 			virtAddr, KernelPageTableSize);
 	    return AddressErrorException;
 	} else if (!KernelPageTable[vpn].valid) {
-	    DEBUG('a', "virtual page # %d too large for page table size %d!\n", 
+	    if (Trace)
+		DEBUG('a', "virtual page # %d too large for page table size %d!\n", 
 			virtAddr, KernelPageTableSize);
 	    return PageFaultException;
 	}
 	entry = &KernelPageTable[vpn];
     } else {
-        for (entry = NULL, i = 0; i < TLBSize; i++)
-    	    if (tlb[i].valid && (tlb[i].virtualPage == vpn)) {
+	first = (vpn % (tlbSize / tlbWays)) * tlbWays;	// look in vpn's set
+        for (entry = NULL, i = first; i < first + tlbWays; i++)
+    	    if (tlb[i].valid && (tlb[i].virtualPage == (int) vpn)) {
 		entry = &tlb[i];			// FOUND!
+		tlbLastUse[i] = stats->totalTicks;
 		break;
 	    }
 	if (entry == NULL) {				// not found
-    	    DEBUG('a', "*** no valid TLB entry found for this virtual page!\n");
+	    if (Trace)
+		DEBUG('a', "*** no valid TLB entry found for this virtual page!\n");
+	    stats->numTLBMisses++;
     	    return PageFaultException;		// really, this is a TLB fault,
 						// the page may be in memory,
 						// but not in the TLB
 	}
+	stats->numTLBHits++;
     }
 
     if (entry->readOnly && writing) {	// trying to write to a read-only page
-	DEBUG('a', "%d mapped read-only at %d in TLB!\n", virtAddr, i);
+	if (Trace)
+	    DEBUG('a', "%d mapped read-only at %d in TLB!\n", virtAddr, i);
 	return ReadOnlyException;
     }
     pageFrame = entry->physicalPage;
@@ -245,7 +556,8 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
     // if the pageFrame is too big, there is something really wrong! 
     // An invalid translation was loaded into the page table or TLB. 
     if (pageFrame >= NumPhysPages) { 
-	DEBUG('a', "*** frame %d > %d!\n", pageFrame, NumPhysPages);
+	if (Trace)
+	    DEBUG('a', "*** frame %d > %d!\n", pageFrame, NumPhysPages);
 	return BusErrorException;
     }
     entry->use = TRUE;		// set the use, dirty bits
@@ -253,7 +565,8 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
 	entry->dirty = TRUE;
     *physAddr = pageFrame * PageSize + offset;
     ASSERT((*physAddr >= 0) && ((*physAddr + size) <= MemorySize));
-    DEBUG('a', "phys addr = 0x%x\n", *physAddr);
+    if (Trace)
+	DEBUG('a', "phys addr = 0x%x\n", *physAddr);
     return NoException;
 }
 
@@ -281,3 +594,23 @@ Machine::GetPA (unsigned vaddr)
    }
    else return -1;
 }
+
+//----------------------------------------------------------------------
+// The variants of the routines above that mipssim.cc calls, one for
+// each combination of tracing and TLB (see Machine::Run).
+//----------------------------------------------------------------------
+
+#define INSTANTIATE(Trace, UseTLB)					\
+template bool Machine::ReadMem<Trace, UseTLB>(int addr, int size,	\
+					      int *value);		\
+template bool Machine::WriteMem<Trace, UseTLB>(int addr, int size,	\
+					       int value);		\
+template bool Machine::FetchInstruction<Trace, UseTLB>(int addr,	\
+					       Instruction *instr);	\
+template Instruction *Machine::FetchBlock<Trace, UseTLB>(int addr,	\
+					       int *length, int *physPage)
+
+INSTANTIATE(false, false);
+INSTANTIATE(false, true);
+INSTANTIATE(true, false);
+INSTANTIATE(true, true);
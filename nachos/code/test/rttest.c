@@ -0,0 +1,79 @@
+#include "syscall.h"
+
+#define PERIOD 2000
+#define NUM_JOBS 5
+#define WORK 40
+#define HOG_WORK 4000
+#define SIZE 10
+
+/* Run NUM_JOBS jobs, one in each period, sleeping until the next. */
+void
+RunJobs (int start)
+{
+    int array[SIZE], i, k, job, sum = 0;
+    int next;
+
+    for (job=0; job<NUM_JOBS; job++) {
+       for (k=0; k<WORK; k++)
+          for (i=0; i<SIZE; i++) sum += array[i];
+       syscall_wrapper_PrintString("[pid ");
+       syscall_wrapper_PrintInt(syscall_wrapper_GetPID());
+       syscall_wrapper_PrintString("] job ");
+       syscall_wrapper_PrintInt(job);
+       syscall_wrapper_PrintString(" done at ");
+       syscall_wrapper_PrintInt(syscall_wrapper_GetTime());
+       syscall_wrapper_PrintString(", deadline ");
+       next = start + (job+1)*PERIOD;
+       syscall_wrapper_PrintInt(next);
+       syscall_wrapper_PrintChar('\n');
+       if (next > syscall_wrapper_GetTime())
+          syscall_wrapper_Sleep(next - syscall_wrapper_GetTime());
+    }
+}
+
+int
+main()
+{
+    int array[SIZE], i, k, sum = 0;
+    int hog, x, r;
+
+    /* An ordinary thread that wants the CPU all the time */
+    hog = syscall_wrapper_Fork();
+    if (hog == 0) {
+       for (k=0; k<HOG_WORK; k++)
+          for (i=0; i<SIZE; i++) sum += array[i];
+       syscall_wrapper_PrintString("Hog done at ");
+       syscall_wrapper_PrintInt(syscall_wrapper_GetTime());
+       syscall_wrapper_PrintChar('\n');
+       return 0;
+    }
+
+    r = syscall_wrapper_SetRealTime(PERIOD, (3*PERIOD)/10);
+    syscall_wrapper_PrintString("Reserving 30% returned ");
+    syscall_wrapper_PrintInt(r);
+    syscall_wrapper_PrintChar('\n');
+
+    x = syscall_wrapper_Fork();
+    if (x == 0) {
+       /* 30% + 70% is over RT_MAX_UTILIZATION (90%): refused */
+       r = syscall_wrapper_SetRealTime(PERIOD, (7*PERIOD)/10);
+       syscall_wrapper_PrintString("Reserving 70% more returned ");
+       syscall_wrapper_PrintInt(r);
+       syscall_wrapper_PrintChar('\n');
+       r = syscall_wrapper_SetRealTime(PERIOD, (5*PERIOD)/10);
+       syscall_wrapper_PrintString("Reserving 50% more returned ");
+       syscall_wrapper_PrintInt(r);
+       syscall_wrapper_PrintChar('\n');
+       RunJobs(syscall_wrapper_GetTime());
+       return 0;
+    }
+
+    RunJobs(syscall_wrapper_GetTime());
+    r = syscall_wrapper_SetRealTime(0, 0);
+    syscall_wrapper_PrintString("Releasing the reservation returned ");
+    syscall_wrapper_PrintInt(r);
+    syscall_wrapper_PrintChar('\n');
+    syscall_wrapper_Join(x);
+    syscall_wrapper_Join(hog);
+    return 0;
+}
@@ -274,6 +274,14 @@ syscall_wrapper_ShmAllocate:
         j       $31
         .end syscall_wrapper_ShmAllocate
 
+	.globl syscall_wrapper_SetRealTime
+	.ent    syscall_wrapper_SetRealTime
+syscall_wrapper_SetRealTime:
+	addiu $2,$0,SysCall_SetRealTime
+	syscall
+	j	$31
+	.end syscall_wrapper_SetRealTime
+
 /* dummy function to keep gcc happy */
         .globl  __main
         .ent    __main
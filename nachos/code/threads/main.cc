@@ -8,8 +8,17 @@
 //
 // 	Most of this file is not needed until later assignments.
 //
-// Usage: nachos -d <debugflags> -rs <random seed #>
-//		-s -x <nachos file> -c <consoleIn> <consoleOut>
+// Usage: nachos -d <debugflags> -rs <random seed #> -cpus <# of CPUs>
+//		-q <time slice> -adaptive <min time slice> <max time slice>
+//		-M <# of physical pages> -tickless
+//		-mlfq <# of queues> <time slice> -boost <period>
+//		-estimator <burst estimator> -trace <trace file> <# of events>
+//		-s -bb -eh -x <nachos file> -c <consoleIn> <consoleOut>
+//		-tlb <entries> -tlbways <ways> -tlbrepl <policy>
+//		-icache <sets> <ways> <line size> <policy>
+//		-dcache <sets> <ways> <line size> <policy> -cachepenalty <ticks>
+//		-prof <profile file> -ckpt <checkpoint file> <time>
+//		-restore <checkpoint file>
 //		-f -cp <unix file> <nachos file>
 //		-p <nachos file> -r <nachos file> -l -D -t
 //              -n <network reliability> -m <machine id>
@@ -18,10 +27,40 @@
 //
 //    -d causes certain debugging messages to be printed (cf. utility.h)
 //    -rs causes Yield to occur at random (but repeatable) spots
+//    -cpus sets the number of simulated CPUs (default 1)
+//    -q sets the time slice of the preemptive schedulers (default 100)
+//    -adaptive lets the round robin and UNIX schedulers change the time
+//	slice (starting from -q), between these bounds, to suit the CPU
+//	bursts and the number of ready threads (see TuneQuantum)
+//    -mlfq sets the number of queues of the MLFQ scheduler (default 3),
+//	and the time slice of the top one (default: as -q); each queue
+//	below has twice the time slice of the one above
+//    -boost sets how often MLFQ moves every thread to the top queue
+//	(default 2000 ticks)
+//    -estimator sets how SJF and SRTF estimate the next CPU burst: 0 an
+//	exponential average (the default), 1 a histogram of past bursts
+//    -trace records the last so many scheduling events (see schedtrace.h)
+//	and writes them to this file when Nachos halts, for bin/schedstat
+//    -M limits the physical pages user programs may use
+//    -tickless only takes timer interrupts when a time slice ends or a
+//	sleeping thread is due to wake up, instead of every TimerTicks
 //    -z prints the copyright message
 //
 //  USER_PROGRAM
 //    -s causes user programs to be executed in single-step mode
+//    -bb causes user programs to be executed a basic block at a time
+//    -eh only checks for interrupts at the ticks when one can be due
+//    -tlb translates through a TLB with this many entries
+//    -tlbways sets how many TLB entries make up a set (default: all)
+//    -tlbrepl sets the TLB replacement policy: 0 FIFO, 1 random, 2 LRU
+//    -icache, -dcache model an L1 instruction or data cache, with this
+//	many sets, of this many lines, of this many bytes, replaced with
+//	this policy (numbered as for -tlbrepl)
+//    -cachepenalty charges this many ticks for each cache miss (default 0)
+//    -prof profiles user programs, writing the profiles to this file
+//    -ckpt writes a checkpoint of the simulation to this file, at the
+//	first timer interrupt at or after this time when it can be taken
+//    -restore carries on from a checkpoint (instead of -x or -F)
 //    -x runs a user program
 //    -c tests the console
 //
@@ -62,6 +101,7 @@ extern void LaunchUserProcess(char *file), ConsoleTest(char *in, char *out);
 extern void MailTest(int networkID);
 
 extern void ReadInputAndFork(char *file);
+extern void RestoreCheckpoint(char *file);
 
 //----------------------------------------------------------------------
 // main
@@ -100,9 +140,9 @@ main(int argc, char **argv)
         if (!strcmp(*argv, "-A")) {		// read scheduling algorithm
            schedulingAlgo = atoi(*(argv + 1));
            argCount = 2;
-           ASSERT((schedulingAlgo > 0) && (schedulingAlgo <= 4));
+           ASSERT((schedulingAlgo > 0) && (schedulingAlgo <= SRTF_SCHED));
            if ((schedulingAlgo == ROUND_ROBIN) || (schedulingAlgo == UNIX_SCHED)) {
-              ASSERT (SCHED_QUANTUM > 0);
+              ASSERT (schedQuantum > 0);
            }
            if (schedulingAlgo == UNIX_SCHED) {
               currentThread->SetBasePriority(schedPriority+DEFAULT_BASE_PRIORITY);
@@ -143,6 +183,10 @@ main(int argc, char **argv)
             ASSERT (argc > 1);
             ReadInputAndFork(*(argv + 1));
             argCount = 2;
+        } else if (!strcmp(*argv, "-restore")) {	// carry on from a checkpoint
+            ASSERT (argc > 1);
+            RestoreCheckpoint(*(argv + 1));
+            argCount = 2;
         }
 #endif // USER_PROGRAM
 #ifdef FILESYS
@@ -0,0 +1,251 @@
+// runqueue.cc
+//	Routines to manage the queue of threads that are ready to run:
+//	sorted buckets by key, with a two level bitmap of the buckets that
+//	are not empty.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "runqueue.h"
+#include "system.h"
+
+//----------------------------------------------------------------------
+// RunQueue::RunQueue
+// 	Initialize an empty run queue, allocating an entry for each of
+//	the "maxThreads" pids.
+//----------------------------------------------------------------------
+
+RunQueue::RunQueue(int maxThreads)
+{
+    int i;
+
+    size = maxThreads;
+    pool = new RunQueueEntry[size];
+    for (i = 0; i < size; i++)
+	pool[i].thread = NULL;
+    for (i = 0; i < NumRunQueueBuckets; i++)
+	first[i] = last[i] = NULL;
+    for (i = 0; i < NumRunQueueBuckets / 32; i++)
+	bits[i] = 0;
+    summary = 0;
+    oldest = newest = NULL;
+    numReady = 0;
+    stale = FALSE;
+}
+
+RunQueue::~RunQueue()
+{
+    delete [] pool;
+}
+
+//----------------------------------------------------------------------
+// RunQueue::Bucket
+// 	Return the bucket for key "key": the key itself if it is below
+//	NumLinearBuckets, and otherwise one of 16 buckets for its power of
+//	two, picked by the four bits after its leading one.  Larger keys
+//	never go in an earlier bucket.
+//----------------------------------------------------------------------
+
+int
+RunQueue::Bucket(int key)
+{
+    int log;
+
+    if (key < NumLinearBuckets)
+	return key;
+    log = 31 - __builtin_clz(key);		// at least 9
+    return NumLinearBuckets + (log - 9) * 16 + ((key >> (log - 4)) & 15);
+}
+
+//----------------------------------------------------------------------
+// RunQueue::Link
+// 	Put "entry" in the bucket for its key, after the entries with
+//	smaller or equal keys, marking the bucket as not empty.
+//----------------------------------------------------------------------
+
+void
+RunQueue::Link(RunQueueEntry *entry)
+{
+    int b = Bucket(entry->key);
+    RunQueueEntry *after = last[b];
+
+    while ((after != NULL) && (after->key > entry->key))
+	after = after->prev;
+    entry->prev = after;
+    entry->next = (after == NULL) ? first[b] : after->next;
+    if (first[b] == NULL) {
+	bits[b / 32] |= 1u << (b % 32);
+	summary |= 1u << (b / 32);
+    }
+    if (after == NULL)
+	first[b] = entry;
+    else
+	after->next = entry;
+    if (entry->next == NULL)
+	last[b] = entry;
+    else
+	entry->next->prev = entry;
+}
+
+//----------------------------------------------------------------------
+// RunQueue::Unlink
+// 	Take "entry" out of its bucket, marking the bucket as empty if it
+//	was the only one.
+//----------------------------------------------------------------------
+
+void
+RunQueue::Unlink(RunQueueEntry *entry)
+{
+    int b = Bucket(entry->key);
+
+    if (entry->prev == NULL)
+	first[b] = entry->next;
+    else
+	entry->prev->next = entry->next;
+    if (entry->next == NULL)
+	last[b] = entry->prev;
+    else
+	entry->next->prev = entry->prev;
+    if (first[b] == NULL) {
+	bits[b / 32] &= ~(1u << (b % 32));
+	if (bits[b / 32] == 0)
+	    summary &= ~(1u << (b / 32));
+    }
+}
+
+//----------------------------------------------------------------------
+// RunQueue::Rebuild
+// 	Empty the buckets and refill them from the list of all the queued
+//	threads, so that each bucket is in queue order again after keys
+//	have changed.
+//----------------------------------------------------------------------
+
+void
+RunQueue::Rebuild()
+{
+    RunQueueEntry *entry;
+    int i;
+
+    for (i = 0; i < NumRunQueueBuckets; i++)
+	first[i] = last[i] = NULL;
+    for (i = 0; i < NumRunQueueBuckets / 32; i++)
+	bits[i] = 0;
+    summary = 0;
+    for (entry = oldest; entry != NULL; entry = entry->after)
+	Link(entry);
+    stale = FALSE;
+}
+
+//----------------------------------------------------------------------
+// RunQueue::Append
+// 	Queue "thread" with key "key", behind any others with the same key.
+//----------------------------------------------------------------------
+
+void
+RunQueue::Append(NachOSThread *thread, int key)
+{
+    int pid = thread->GetPID();
+    RunQueueEntry *entry;
+
+    ASSERT((pid >= 0) && (pid < size) && (key >= 0));
+    entry = &pool[pid];
+    ASSERT(entry->thread == NULL);
+    entry->thread = thread;
+    entry->key = key;
+    entry->before = newest;
+    entry->after = NULL;
+    if (newest == NULL)
+	oldest = entry;
+    else
+	newest->after = entry;
+    newest = entry;
+    if (!stale)
+	Link(entry);
+    numReady++;
+}
+
+//----------------------------------------------------------------------
+// RunQueue::Remove
+// 	Take "thread" off the queue, if it is on it.  Returns TRUE if it
+//	was.
+//----------------------------------------------------------------------
+
+bool
+RunQueue::Remove(NachOSThread *thread)
+{
+    int pid = thread->GetPID();
+    RunQueueEntry *entry;
+
+    if ((pid < 0) || (pid >= size) || (pool[pid].thread != thread))
+	return FALSE;
+    entry = &pool[pid];
+    if (!stale)
+	Unlink(entry);
+    if (entry->before == NULL)
+	oldest = entry->after;
+    else
+	entry->before->after = entry->after;
+    if (entry->after == NULL)
+	newest = entry->before;
+    else
+	entry->after->before = entry->before;
+    entry->thread = NULL;
+    numReady--;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// RunQueue::RemoveFirst
+// 	Dequeue and return the thread with the smallest key, the first
+//	queued of those with that key.  Returns NULL if the queue is empty.
+//----------------------------------------------------------------------
+
+NachOSThread *
+RunQueue::RemoveFirst()
+{
+    NachOSThread *thread;
+    int word, b;
+
+    if (numReady == 0)
+	return NULL;
+    if (stale)
+	Rebuild();
+    word = __builtin_ctz(summary);
+    b = word * 32 + __builtin_ctz(bits[word]);
+    thread = first[b]->thread;
+    (void) Remove(thread);
+    return thread;
+}
+
+//----------------------------------------------------------------------
+// RunQueue::SetKey
+// 	Change the key of queued thread "thread" to "key".  The buckets are
+//	rebuilt before the next RemoveFirst.
+//----------------------------------------------------------------------
+
+void
+RunQueue::SetKey(NachOSThread *thread, int key)
+{
+    int pid = thread->GetPID();
+
+    ASSERT((pid >= 0) && (pid < size) && (pool[pid].thread == thread));
+    ASSERT(key >= 0);
+    if (pool[pid].key == key)
+	return;
+    pool[pid].key = key;
+    stale = TRUE;
+}
+
+//----------------------------------------------------------------------
+// RunQueue::Mapcar
+// 	Apply "func" to each queued thread, in the order they were queued.
+//----------------------------------------------------------------------
+
+void
+RunQueue::Mapcar(VoidFunctionPtr func)
+{
+    for (RunQueueEntry *entry = oldest; entry != NULL; entry = entry->after)
+	(*func)((int) entry->thread);
+}
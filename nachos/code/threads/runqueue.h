@@ -0,0 +1,91 @@
+// runqueue.h
+//	Data structures for the queue of threads that are ready to run.
+//
+//	Each thread is queued with a key (its priority, or 0 if the
+//	algorithm has no priorities), and the thread with the smallest key
+//	comes off first; threads with the same key come off in the order
+//	they were queued in.  This is what a linear search of the ready
+//	list for the minimum priority did, but without the search: there is
+//	a FIFO bucket for each key, and a bitmap of the buckets that are
+//	not empty, so queueing and dequeueing take constant time.
+//
+//	Keys below NumLinearBuckets have a bucket each.  Larger keys (SJF
+//	and SRTF burst estimates often are) are mapped to buckets
+//	logarithmically: 16 for each power of two, so that the keys that
+//	share a bucket are within about 6% of each other.  Each bucket is
+//	kept sorted by key (then in the order queued), so its first thread
+//	is always its smallest; queueing in a shared bucket walks back from
+//	its end past the larger keys, which are few.
+//
+//	A queued thread's key can be changed in place, in constant time.
+//	Since threads with the same key must still come off in the order
+//	they were queued in, the buckets are then rebuilt, in one pass over
+//	the threads in the order they were queued in, before the next
+//	dequeue; the UNIX scheduler changes every thread's priority at
+//	once, so this costs no more than the change itself.
+//
+//	The entries are kept in a pool with one entry for each pid.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef RUNQUEUE_H
+#define RUNQUEUE_H
+
+#include "copyright.h"
+#include "thread.h"
+
+#define NumLinearBuckets	512	// keys with a bucket of their own
+#define NumRunQueueBuckets	1024	// 32 words of 32 bits; the keys
+					// above 512 need 352 of them
+
+// The following class defines an entry of the run queue.
+
+class RunQueueEntry {
+  public:
+    NachOSThread *thread;	// the queued thread (NULL if unused)
+    int key;			// its priority
+    RunQueueEntry *prev, *next;	// in its bucket
+    RunQueueEntry *before, *after;	// in the order they were queued in
+};
+
+// The following class defines the run queue, for threads with pids less
+// than "maxThreads".
+
+class RunQueue {
+  public:
+    RunQueue(int maxThreads);		// an empty queue
+    ~RunQueue();
+
+    void Append(NachOSThread *thread, int key);
+					// queue "thread", with key "key"
+    NachOSThread *RemoveFirst();	// dequeue the thread with the
+					// smallest key (NULL if none)
+    bool Remove(NachOSThread *thread);	// take "thread" off, if queued
+    void SetKey(NachOSThread *thread, int key);
+					// change a queued thread's key
+
+    bool IsEmpty() { return (numReady == 0); }
+    int NumReady() { return numReady; }
+    void Mapcar(VoidFunctionPtr func);	// apply "func" to each thread, in
+					// the order they were queued in
+
+  private:
+    int Bucket(int key);		// which bucket "key" goes in
+    void Link(RunQueueEntry *entry);	// put in its bucket, in order
+    void Unlink(RunQueueEntry *entry);	// take out of its bucket
+    void Rebuild();			// refill the buckets in queue order
+
+    RunQueueEntry *pool;		// one entry for each pid
+    int size, numReady;
+    RunQueueEntry *first[NumRunQueueBuckets];	// each bucket's FIFO
+    RunQueueEntry *last[NumRunQueueBuckets];
+    unsigned bits[NumRunQueueBuckets / 32];	// buckets not empty
+    unsigned summary;			// words of "bits" not zero
+    RunQueueEntry *oldest, *newest;	// all of them, in queue order
+    bool stale;				// a key changed; Rebuild before
+					// the next RemoveFirst
+};
+
+#endif // RUNQUEUE_H
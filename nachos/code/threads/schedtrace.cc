@@ -0,0 +1,78 @@
+// schedtrace.cc
+//	Routines to record the trace of scheduling decisions, and to
+//	write it out.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "schedtrace.h"
+
+//----------------------------------------------------------------------
+// SchedTracer::SchedTracer
+// 	Initialize an empty trace, which keeps the last "size" events,
+//	to be written to "fileName" when Nachos halts.
+//----------------------------------------------------------------------
+
+SchedTracer::SchedTracer(char *name, int events)
+{
+    ASSERT(events > 0);
+    fileName = name;
+    size = events;
+    ring = new SchedTraceEvent[size];
+    next = count = numLost = 0;
+}
+
+//----------------------------------------------------------------------
+// SchedTracer::Record
+// 	Add an event to the buffer, overwriting the oldest if it is full.
+//----------------------------------------------------------------------
+
+void
+SchedTracer::Record(int event, int pid, int cpu)
+{
+    SchedTraceEvent *e = &ring[next];
+
+    e->tick = stats->totalTicks;
+    e->pid = pid;
+    e->event = event;
+    e->cpu = cpu;
+    if (++next == size)
+	next = 0;
+    if (count < size)
+	count++;
+    else
+	numLost++;
+}
+
+//----------------------------------------------------------------------
+// SchedTracer::~SchedTracer
+// 	Write the header, then the events in the buffer, oldest first,
+//	to the trace file.
+//----------------------------------------------------------------------
+
+SchedTracer::~SchedTracer()
+{
+    SchedTraceHeader header;
+    FILE *file;
+    int first = (count < size) ? 0 : next;
+
+    if ((file = fopen(fileName, "w")) == NULL) {
+	perror(fileName);
+	delete [] ring;
+	return;
+    }
+    header.magic = SCHED_TRACE_MAGIC;
+    header.numEvents = count;
+    header.numLost = numLost;
+    header.numCPUs = numCPUs;
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(&ring[first], sizeof(SchedTraceEvent), count - first, file);
+    fwrite(ring, sizeof(SchedTraceEvent), first, file);
+    fclose(file);
+    printf("Scheduler trace: %d events written to %s (%d lost)\n",
+	count, fileName, numLost);
+    delete [] ring;
+}
@@ -0,0 +1,74 @@
+// schedtrace.h
+//	Data structures for the trace of scheduling decisions: a compact
+//	record of each event (a thread arriving, made ready, dispatched, blocked,
+//	preempted at the end of its time slice, or exiting), with the
+//	time and the pid, kept in a ring buffer and written out when
+//	Nachos halts.
+//
+//	The trace file is the header followed by the events still in the
+//	buffer, oldest first (in host byte order).  If there were more
+//	events than the buffer holds, the oldest were overwritten, and
+//	the header says how many.  bin/schedstat reads the file, so the
+//	format part of this file is plain C.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef SCHEDTRACE_H
+#define SCHEDTRACE_H
+
+#define SCHED_TRACE_MAGIC	0x5ced7ace	/* marks a trace file */
+
+/* The events */
+#define TRACE_READY	0	/* put on the ready queue */
+#define TRACE_DISPATCH	1	/* given a CPU */
+#define TRACE_SLEEP	2	/* blocked: Sleep, Join, a semaphore... */
+#define TRACE_EXPIRE	3	/* its time slice is over (it is made
+				 * ready once it yields) */
+#define TRACE_EXIT	4	/* finished */
+#define TRACE_ARRIVE	5	/* put on the ready queue for the first
+				 * time (a new thread) */
+
+typedef struct schedTraceHeader {
+    int magic;			/* should be SCHED_TRACE_MAGIC */
+    int numEvents;		/* in the file */
+    int numLost;		/* overwritten before they were written */
+    int numCPUs;
+} SchedTraceHeader;
+
+typedef struct schedTraceEvent {
+    int tick;			/* when */
+    short pid;			/* which thread */
+    char event;			/* what happened to it (TRACE_...) */
+    char cpu;			/* on which CPU */
+} SchedTraceEvent;
+
+#ifdef __cplusplus
+
+#define DEFAULT_SCHED_TRACE_EVENTS	65536	// Buffer size if not given
+
+// The following class records the events, for the scheduler to call as
+// it goes.  Recording an event is a few stores into the buffer.
+
+class SchedTracer {
+  public:
+    SchedTracer(char *fileName, int size);	// keep the last "size" 
+						// events for "fileName"
+    ~SchedTracer();			// write them out
+
+    void Record(int event, int pid, int cpu);	// "event" happened to
+						// "pid" on "cpu", now
+
+  private:
+    char *fileName;
+    SchedTraceEvent *ring;		// the buffer
+    int size;				// how many events it holds
+    int next;				// where the next event goes
+    int count;				// how many are in it
+    int numLost;			// overwritten
+};
+
+#endif // __cplusplus
+
+#endif // SCHEDTRACE_H
@@ -21,6 +21,9 @@
 #include "copyright.h"
 #include "scheduler.h"
 #include "system.h"
+#ifdef USER_PROGRAM
+#include "checkpoint.h"
+#endif
 
 //----------------------------------------------------------------------
 // ProcessScheduler::ProcessScheduler
@@ -29,8 +32,18 @@
 
 ProcessScheduler::ProcessScheduler()
 { 
-    listOfReadyThreads = new List;
+    listOfReadyThreads = new RunQueue(MAX_THREAD_COUNT);
+    fairTree = new ThreadTree(MAX_THREAD_COUNT);
+    realTimeTree = new ThreadTree(MAX_THREAD_COUNT);
+    depletedTree = new ThreadTree(MAX_THREAD_COUNT);
+    rtUtilization = 0;
     empty_ready_queue_start_time = -1;
+    decayEpoch = 0;
+    minVirtualRuntime = 0;
+    readyWeight = 0;
+    boostEpoch = 0;
+    nextBoost = mlfqBoostPeriod;
+    StartTuning();
 } 
 
 //----------------------------------------------------------------------
@@ -41,6 +54,9 @@ ProcessScheduler::ProcessScheduler()
 ProcessScheduler::~ProcessScheduler()
 { 
     delete listOfReadyThreads; 
+    delete fairTree;
+    delete realTimeTree;
+    delete depletedTree;
 } 
 
 //----------------------------------------------------------------------
@@ -56,7 +72,9 @@ ProcessScheduler::MoveThreadToReadyQueue (NachOSThread *thread)
 {
     DEBUG('t', "Putting thread %s with pid %d on ready list.\n", thread->getName(), thread->GetPID());
 
-    if (thread->getStatus() == RUNNING) {
+    bool wasRunning = (thread->getStatus() == RUNNING);
+    bool isNew = (thread->getStatus() == JUST_CREATED);
+    if (wasRunning) {
        stats->cpu_time += (stats->totalTicks - cpu_burst_start_time);
        if ((stats->totalTicks - cpu_burst_start_time) > 0) {
           stats->cpu_burst_count++;
@@ -67,27 +85,119 @@ ProcessScheduler::MoveThreadToReadyQueue (NachOSThread *thread)
           if ((stats->totalTicks - cpu_burst_start_time) < stats->min_cpu_burst) {
              stats->min_cpu_burst = (stats->totalTicks - cpu_burst_start_time);
           }
+          if (thread->IsRealTime()) {
+             ChargeRealTime(thread, stats->totalTicks - cpu_burst_start_time);
+          }
           if (schedulingAlgo == UNIX_SCHED) {
              UpdateThreadPriority();
           }
           else if (schedulingAlgo == NON_PREEMPTIVE_SJF) {
-             stats->burstEstimateError += abs(stats->totalTicks - cpu_burst_start_time - thread->GetPriority());
-             thread->SetPriority((int)(ALPHA*(stats->totalTicks - cpu_burst_start_time) + (1-ALPHA)*thread->GetPriority()));
+             EndBurst(thread, stats->totalTicks - cpu_burst_start_time);
+          }
+          else if (schedulingAlgo == SRTF_SCHED) {
+             // Preempted: the burst goes on when it runs again
+             thread->AddBurstRun(stats->totalTicks - cpu_burst_start_time);
+          }
+          else if ((schedulingAlgo == CFS_SCHED) || (schedulingAlgo == STRIDE_SCHED)) {
+             ChargeVirtualRuntime(thread, stats->totalTicks - cpu_burst_start_time);
           }
+          else if (schedulingAlgo == MLFQ_SCHED) {
+             QuantumUsed(thread, stats->totalTicks - cpu_burst_start_time);
+          }
+       }
+    }
+    if (schedulingAlgo == UNIX_SCHED) {
+       CatchUpUsage(thread);		// it has been away from the queue
+    }
+    if (thread->IsRealTime() && (thread->getStatus() == BLOCKED)) {
+       // Back from waiting for its next period: a new job, due at the
+       // end of the period that starts now (but not before the last one
+       // was over)
+       int release = (stats->totalTicks > thread->GetDeadline()) ? stats->totalTicks
+							: thread->GetDeadline();
+       thread->StartJob(release + thread->GetPeriod());
+    }
+    if ((schedulingAlgo == MLFQ_SCHED) && (thread->getStatus() == BLOCKED)) {
+       // Back from a sleep or a wait: it didn't use up its time slice,
+       // so move it up a queue
+       CatchUpBoost(thread);
+       if (thread->GetLevel() > 0) {
+          thread->SetLevel(thread->GetLevel() - 1, boostEpoch);
+          stats->mlfqPromotions++;
        }
     }
     thread->setStatus(READY);
     thread->SetWaitStartTime(stats->totalTicks);
-    if (listOfReadyThreads->IsEmpty() && (empty_ready_queue_start_time != -1)) {
+    if (schedTracer != NULL)
+       schedTracer->Record(isNew ? TRACE_ARRIVE : TRACE_READY, thread->GetPID(), currentCPU);
+    if (NoneReady() && (empty_ready_queue_start_time != -1)) {
        stats->empty_ready_queue_time += (stats->totalTicks - empty_ready_queue_start_time);
        empty_ready_queue_start_time = -1;
     }
-    listOfReadyThreads->Append((void *)thread);
+    if (HasBudget(thread)) {
+       realTimeTree->Insert(thread, thread->GetDeadline());
+    }
+    else if ((schedulingAlgo == CFS_SCHED) || (schedulingAlgo == STRIDE_SCHED)) {
+       // A thread that was asleep or blocked gets at most half a latency
+       // of credit (none, under stride scheduling), so that it can't then
+       // hog the CPU
+       int credit = (schedulingAlgo == CFS_SCHED) ? CFS_TARGET_LATENCY/2 : 0;
+       if (!wasRunning && (thread->GetVirtualRuntime() < minVirtualRuntime - credit))
+          thread->SetVirtualRuntime(minVirtualRuntime - credit, 0);
+       fairTree->Insert(thread, thread->GetVirtualRuntime());
+       readyWeight += Weight(thread);
+    }
+    else {
+       listOfReadyThreads->Append(thread, ReadyKey(thread));
+    }
+    if (HasBudget(thread) && !wasRunning) {
+       PreemptForRealTime(thread);
+    }
+    else if ((schedulingAlgo == SRTF_SCHED) && !wasRunning) {
+       PreemptIfShorter(thread);
+    }
+}
+
+//----------------------------------------------------------------------
+// ProcessScheduler::ReadyKey
+// 	Return the key "thread" is ordered by in the ready queue: its
+//	priority (the burst estimate, for SJF, or what is left of it, for
+//	SRTF), its queue for MLFQ, or 0 for the algorithms that run the 
+//	ready threads in FIFO order.
+//----------------------------------------------------------------------
+
+int
+ProcessScheduler::ReadyKey (NachOSThread *thread)
+{
+    if ((schedulingAlgo == UNIX_SCHED) || (schedulingAlgo == NON_PREEMPTIVE_SJF))
+       return thread->GetPriority();
+    if (schedulingAlgo == SRTF_SCHED)
+       return RemainingEstimate(thread);
+    if (schedulingAlgo == MLFQ_SCHED) {
+       CatchUpBoost(thread);
+       return thread->GetLevel();
+    }
+    return 0;
+}
+
+//----------------------------------------------------------------------
+// ProcessScheduler::PriorityChanged
+// 	The priority of "thread" was changed; if it is on the ready queue,
+//	move it to its new place there.
+//----------------------------------------------------------------------
+
+void
+ProcessScheduler::PriorityChanged (NachOSThread *thread)
+{
+    if (thread->getStatus() == READY)
+       listOfReadyThreads->SetKey(thread, ReadyKey(thread));
 }
 
 //----------------------------------------------------------------------
 // ProcessScheduler::SelectNextReadyThread
-// 	Return the next thread to be scheduled onto the CPU.
+// 	Return the next thread to be scheduled onto the CPU: the real-time
+//	thread with the earliest deadline, if any has budget left, or else
+//	the one the scheduling algorithm picks.
 //	If there are no ready threads, return NULL.
 // Side effect:
 //	NachOSThread is removed from the ready list.
@@ -96,12 +206,26 @@ ProcessScheduler::MoveThreadToReadyQueue (NachOSThread *thread)
 NachOSThread *
 ProcessScheduler::SelectNextReadyThread ()
 {
-    if ((schedulingAlgo == UNIX_SCHED) || (schedulingAlgo == NON_PREEMPTIVE_SJF)){
-       return (NachOSThread *)listOfReadyThreads->GetMinPriorityThread();
-    }
-    else {
-       return (NachOSThread *)listOfReadyThreads->Remove();
+    NachOSThread *thread;
+    int spread;
+
+    if (!realTimeTree->IsEmpty())
+       return realTimeTree->RemoveFirst();
+    if ((schedulingAlgo == CFS_SCHED) || (schedulingAlgo == STRIDE_SCHED)) {	// the least virtual runtime
+       if (fairTree->IsEmpty())
+          return NULL;
+       spread = fairTree->LastKey() - fairTree->FirstKey();
+       stats->cfsDispatches++;
+       stats->cfsSpreadTotal += spread;
+       if (spread > stats->cfsMaxSpread)
+          stats->cfsMaxSpread = spread;
+       thread = fairTree->RemoveFirst();
+       readyWeight -= Weight(thread);
+       UpdateMinVirtualRuntime();
+       return thread;
     }
+    return listOfReadyThreads->RemoveFirst();	// the minimum priority, 
+						// or FIFO (see ReadyKey)
 }
 
 //----------------------------------------------------------------------
@@ -126,6 +250,7 @@ ProcessScheduler::ScheduleThread (NachOSThread *nextThread)
     cpu_burst_start_time = stats->totalTicks;
     nextThread->SetCPUBurstStartTime(cpu_burst_start_time);
     stats->total_wait_time += (stats->totalTicks - nextThread->GetWaitStartTime());
+    nextThread->AddReadyTicks(stats->totalTicks - nextThread->GetWaitStartTime());
 
 #ifdef USER_PROGRAM			// ignore until running user programs 
     if (currentThread->space != NULL) {	// if this thread is a user program,
@@ -139,6 +264,11 @@ ProcessScheduler::ScheduleThread (NachOSThread *nextThread)
 
     currentThread = nextThread;		    // switch to the next thread
     currentThread->setStatus(RUNNING);      // nextThread is now running
+    cpuThread[currentCPU] = nextThread;	    // on the CPU we were on
+    cpuPreempt[currentCPU] = FALSE;
+    if (schedTracer != NULL)
+       schedTracer->Record(TRACE_DISPATCH, nextThread->GetPID(), currentCPU);
+    SetNextTimerInterrupt();		    // its time slice has started
     DEBUG('t', "Switching from thread \"%s\" with pid %d to thread \"%s\" with pid %d\n",
 	  oldThread->getName(), oldThread->GetPID(), nextThread->getName(), nextThread->GetPID());
     
@@ -195,6 +325,241 @@ ProcessScheduler::Tail ()
 #endif
 }
 
+//----------------------------------------------------------------------
+// ProcessScheduler::NextCPU
+//      Called by the simulator after each user instruction when there
+//	are several CPUs.  The CPUs take turns, one instruction at a time,
+//	in CPU order; once every busy CPU has had its turn, simulated
+//	time advances by one tick, and ready threads are dispatched to
+//	the idle CPUs.  
+//
+//	All CPUs share the one Machine: its registers hold the registers 
+//	of the CPU whose turn it is, and each thread's saved user 
+//	registers hold those of the CPU it runs on.  Kernel code is not
+//	interleaved; it runs on one CPU at a time, as if under a single
+//	kernel lock.
+//----------------------------------------------------------------------
+
+void
+ProcessScheduler::NextCPU ()
+{
+    int cpu;
+
+    for (cpu = currentCPU + 1; (cpu < numCPUs) && (cpuThread[cpu] == NULL); cpu++)
+       ;
+    if (cpu == numCPUs) {		// every busy CPU has had its turn
+       for (cpu = 0; cpu < numCPUs; cpu++)
+          if (cpuThread[cpu] != NULL)
+             stats->cpuBusyTicks[cpu] += UserTick;
+       interrupt->OneTick();
+       FillIdleCPUs();
+       for (cpu = 0; cpuThread[cpu] == NULL; cpu++)
+          ;
+    }
+    if (cpu != currentCPU) {
+       SwitchToCPU(cpu);
+       // We are back; see if our time slice ran out while we were away
+       if (cpuPreempt[currentCPU]) {
+          cpuPreempt[currentCPU] = FALSE;
+          MachineStatus old = interrupt->getStatus();
+          interrupt->setStatus(SystemMode);	// yield is a kernel routine
+          currentThread->YieldCPU();
+          interrupt->setStatus(old);
+       }
+    }
+}
+
+//----------------------------------------------------------------------
+// ProcessScheduler::ReleaseCPU
+//      Called when the current thread stops running and there is nothing
+//	on the ready list to replace it.  If another CPU is busy, leave
+//	this one idle and carry on with that one; we get back here once 
+//	this thread has been dispatched again, to some CPU.
+//
+//	Returns FALSE, doing nothing, if there is no other busy CPU (in 
+//	particular, if there is only one CPU).
+//----------------------------------------------------------------------
+
+bool
+ProcessScheduler::ReleaseCPU ()
+{
+    int cpu;
+
+    for (cpu = 0; cpu < numCPUs; cpu++)
+       if ((cpu != currentCPU) && (cpuThread[cpu] != NULL))
+          break;
+    if (cpu == numCPUs)
+       return FALSE;
+    cpuThread[currentCPU] = NULL;
+    SwitchToCPU(cpu);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// ProcessScheduler::SwitchToCPU
+//      Carry on with the thread on "cpu".  Unlike ScheduleThread, this
+//	is not a dispatch: the current thread stays on its CPU (if it
+//	still has one), and the burst and wait statistics are untouched.
+//----------------------------------------------------------------------
+
+void
+ProcessScheduler::SwitchToCPU (int cpu)
+{
+    NachOSThread *oldThread = currentThread;
+    NachOSThread *nextThread = cpuThread[cpu];
+
+    ASSERT(nextThread != NULL);
+#ifdef USER_PROGRAM
+    if (currentThread->space != NULL) {	// if this thread is a user program,
+        currentThread->SaveUserState(); // save the user's CPU registers
+	currentThread->space->SaveContextOnSwitch();
+    }
+#endif
+
+    oldThread->CheckOverflow();
+
+    currentCPU = cpu;
+    currentThread = nextThread;
+    cpu_burst_start_time = nextThread->GetCPUBurstStartTime();
+    DEBUG('t', "Switching to CPU %d, running \"%s\" with pid %d\n",
+	  cpu, nextThread->getName(), nextThread->GetPID());
+
+    _SWITCH(oldThread, nextThread);
+
+    if (threadToBeDestroyed != NULL) {
+        delete threadToBeDestroyed;
+	threadToBeDestroyed = NULL;
+    }
+    
+#ifdef USER_PROGRAM
+    if (currentThread->space != NULL) {		// if there is an address space
+        currentThread->RestoreUserState();     // to restore, do it.
+	currentThread->space->RestoreContextOnSwitch();
+    }
+#endif
+}
+
+//----------------------------------------------------------------------
+// ProcessScheduler::FillIdleCPUs
+//      Dispatch threads from the ready list to the idle CPUs.  They
+//	start running when their CPU's turn comes; the timer is told 
+//	when their time slices end.
+//----------------------------------------------------------------------
+
+void
+ProcessScheduler::FillIdleCPUs ()
+{
+    NachOSThread *thread;
+    bool started = FALSE;
+
+    for (int cpu = 0; cpu < numCPUs; cpu++) {
+       if (cpuThread[cpu] != NULL)
+          continue;
+       thread = SelectNextReadyThread();
+       if (thread == NULL)
+          break;
+       thread->SetCPUBurstStartTime(stats->totalTicks);
+       stats->total_wait_time += (stats->totalTicks - thread->GetWaitStartTime());
+       thread->AddReadyTicks(stats->totalTicks - thread->GetWaitStartTime());
+       thread->setStatus(RUNNING);
+       cpuThread[cpu] = thread;
+       cpuPreempt[cpu] = FALSE;
+       if (schedTracer != NULL)
+          schedTracer->Record(TRACE_DISPATCH, thread->GetPID(), cpu);
+       started = TRUE;
+    }
+    if (started)
+       SetNextTimerInterrupt();
+}
+
+#ifdef USER_PROGRAM
+//----------------------------------------------------------------------
+// ProcessScheduler::WriteCheckpoint
+//      Save the ready list (as pids, in order) to a checkpoint file.
+//----------------------------------------------------------------------
+
+static FILE *checkpointReadyFile;	// for CheckpointReadyThread
+
+static void
+CheckpointReadyThread (int arg)
+{
+    int pid = ((NachOSThread *)arg)->GetPID();
+
+    CheckpointWrite(checkpointReadyFile, &pid, sizeof(pid));
+}
+
+void
+ProcessScheduler::WriteCheckpoint (FILE *file)
+{
+    int pid;
+
+    checkpointReadyFile = file;
+    realTimeTree->Mapcar(CheckpointReadyThread);
+    listOfReadyThreads->Mapcar(CheckpointReadyThread);
+    fairTree->Mapcar(CheckpointReadyThread);
+    pid = -1;
+    CheckpointWrite(file, &pid, sizeof(pid));
+    CheckpointWrite(file, &empty_ready_queue_start_time, sizeof(int));
+    CheckpointWrite(file, &minVirtualRuntime, sizeof(int));
+    CheckpointWrite(file, &nextBoost, sizeof(int));
+    CheckpointWrite(file, &rtUtilization, sizeof(double));
+    CheckpointWrite(file, &nextTune, sizeof(int));
+    CheckpointWrite(file, &tuneBursts, sizeof(int));
+    CheckpointWrite(file, &tuneCPUTime, sizeof(int));
+    CheckpointWrite(file, &tuneSwitches, sizeof(int));
+    CheckpointWrite(file, &tuneSystemTicks, sizeof(int));
+    CheckpointWrite(file, &readySamples, sizeof(int));
+    CheckpointWrite(file, &readyTotal, sizeof(int));
+}
+
+//----------------------------------------------------------------------
+// ProcessScheduler::ReadCheckpoint
+//      Restore the ready list saved by WriteCheckpoint.  The threads'
+//      wait and burst times are restored with the threads.
+//----------------------------------------------------------------------
+
+void
+ProcessScheduler::ReadCheckpoint (FILE *file)
+{
+    NachOSThread *thread;
+    int pid;
+
+    ASSERT(listOfReadyThreads->IsEmpty());
+    for (;;) {
+       CheckpointRead(file, &pid, sizeof(pid));
+       if (pid == -1)
+          break;
+       ASSERT(threadArray[pid] != NULL);
+       if (HasBudget(threadArray[pid]))
+          realTimeTree->Insert(threadArray[pid], threadArray[pid]->GetDeadline());
+       else if ((schedulingAlgo == CFS_SCHED) || (schedulingAlgo == STRIDE_SCHED)) {
+          fairTree->Insert(threadArray[pid], threadArray[pid]->GetVirtualRuntime());
+          readyWeight += Weight(threadArray[pid]);
+       }
+       else
+          listOfReadyThreads->Append(threadArray[pid], ReadyKey(threadArray[pid]));
+    }
+    // The real-time threads waiting for their next budgets
+    for (pid = 0; pid < (int) thread_index; pid++) {
+       thread = threadArray[pid];
+       if ((thread != NULL) && thread->IsRealTime() && !HasBudget(thread)
+           && (thread->getStatus() != BLOCKED))
+          depletedTree->Insert(thread, thread->GetDeadline());
+    }
+    CheckpointRead(file, &empty_ready_queue_start_time, sizeof(int));
+    CheckpointRead(file, &minVirtualRuntime, sizeof(int));
+    CheckpointRead(file, &nextBoost, sizeof(int));
+    CheckpointRead(file, &rtUtilization, sizeof(double));
+    CheckpointRead(file, &nextTune, sizeof(int));
+    CheckpointRead(file, &tuneBursts, sizeof(int));
+    CheckpointRead(file, &tuneCPUTime, sizeof(int));
+    CheckpointRead(file, &tuneSwitches, sizeof(int));
+    CheckpointRead(file, &tuneSystemTicks, sizeof(int));
+    CheckpointRead(file, &readySamples, sizeof(int));
+    CheckpointRead(file, &readyTotal, sizeof(int));
+}
+#endif
+
 //----------------------------------------------------------------------
 // ProcessScheduler::Print
 // 	Print the scheduler state -- in other words, the contents of
@@ -204,7 +569,9 @@ void
 ProcessScheduler::Print()
 {
     printf("Ready list contents:\n");
+    realTimeTree->Mapcar((VoidFunctionPtr) ThreadPrint);
     listOfReadyThreads->Mapcar((VoidFunctionPtr) ThreadPrint);
+    fairTree->Mapcar((VoidFunctionPtr) ThreadPrint);
 }
 
 void
@@ -215,34 +582,594 @@ ProcessScheduler::SetEmptyReadyQueueStartTime (int ticks)
 
 //-------------------------------------------------------------------------
 // ProcessScheduler::UpdateThreadPriority
-//      Updates the priority of all active threads as in the UNIX scheduler
+//      Updates the priority of all active threads as in the UNIX scheduler:
+//	at the end of each CPU burst, the usage of the current thread is
+//	averaged with the length of the burst, the usage of every other 
+//	thread is halved, and each priority is the base priority plus half
+//	the usage.
+//
+//	Only the threads on the ready queue, whose priorities order the
+//	queue, are updated here.  The others just miss a decay; they catch
+//	up, in CatchUpUsage, before their usage or priority is next used.
 //--------------------------------------------------------------------------
+
+static void
+DecayReadyThread (int arg)
+{
+   NachOSThread *thread = (NachOSThread *)arg;
+
+   scheduler->CatchUpUsage(thread);
+   scheduler->PriorityChanged(thread);
+}
+
 void
 ProcessScheduler::UpdateThreadPriority (void)
 {
-   unsigned i;
    int this_cpu_burst_duration = stats->totalTicks - cpu_burst_start_time;
    ASSERT(this_cpu_burst_duration > 0);
-   unsigned currentPID = currentThread->GetPID();
 
    // First we update the currentThread priority
 
+   CatchUpUsage(currentThread);
    int currentThreadUsage = currentThread->GetUsage();
    currentThreadUsage = (currentThreadUsage + this_cpu_burst_duration) >> 1;
    int currentThreadPriority = currentThread->GetBasePriority() + (currentThreadUsage >> 1);
    currentThread->SetUsage(currentThreadUsage);
    currentThread->SetPriority(currentThreadPriority);
 
-   // Update everybody else
+   // Decay everybody else
+
+   decayEpoch++;
+   currentThread->SetDecayEpoch(decayEpoch);
+   listOfReadyThreads->Mapcar(DecayReadyThread);
+}
+
+//-------------------------------------------------------------------------
+// ProcessScheduler::CatchUpUsage
+//      Apply to "thread" the decays it missed since it was last updated:
+//	halving the usage n times is shifting it right by n bits.
+//--------------------------------------------------------------------------
+void
+ProcessScheduler::CatchUpUsage (NachOSThread *thread)
+{
+   unsigned missed = decayEpoch - thread->GetDecayEpoch();
+   int usage;
+
+   if (missed == 0)
+      return;
+   usage = (missed < 32) ? (thread->GetUsage() >> missed) : 0;
+   thread->SetUsage(usage);
+   thread->SetPriority(thread->GetBasePriority() + (usage >> 1));
+   thread->SetDecayEpoch(decayEpoch);
+}
+
+//----------------------------------------------------------------------
+// ProcessScheduler::SlicesTime
+//      Return TRUE if running thread "thread" is preempted when its time
+//	slice is over: under the preemptive algorithms, or if it is a 
+//	real-time thread with budget left (its slice is what is left).
+//----------------------------------------------------------------------
+
+bool
+ProcessScheduler::SlicesTime (NachOSThread *thread)
+{
+   if (HasBudget(thread))
+      return TRUE;
+   return (schedulingAlgo == ROUND_ROBIN) || (schedulingAlgo == UNIX_SCHED)
+	|| (schedulingAlgo == CFS_SCHED) || (schedulingAlgo == MLFQ_SCHED)
+	|| (schedulingAlgo == STRIDE_SCHED);
+}
+
+//----------------------------------------------------------------------
+// ProcessScheduler::TimeSlice
+//      Return how long "thread" may run before it is preempted: the 
+//	quantum, or under CFS, its share by weight of the target latency
+//	among the runnable threads (but at least the minimum granularity),
+//	or under MLFQ, the time slice of its queue.  A real-time thread
+//	may run until its budget for this period is used up.
+//----------------------------------------------------------------------
+
+int
+ProcessScheduler::TimeSlice (NachOSThread *thread)
+{
+   int weight, slice;
+
+   if (HasBudget(thread))
+      return thread->GetBudget() - thread->GetBudgetUsed();
+   if (schedulingAlgo == CFS_SCHED) {
+      weight = Weight(thread);
+      slice = (int)(((double)CFS_TARGET_LATENCY * weight) / (readyWeight + weight));
+      return (slice > CFS_MIN_GRANULARITY) ? slice : CFS_MIN_GRANULARITY;
+   }
+   if (schedulingAlgo == MLFQ_SCHED) {
+      CatchUpBoost(thread);
+      return mlfqQuantum[thread->GetLevel()];
+   }
+   return schedQuantum;
+}
+
+//----------------------------------------------------------------------
+// ProcessScheduler::TuneQuantum
+//      With -adaptive, called at each timer interrupt under the round 
+//	robin and UNIX schedulers.  Count the ready threads, and every
+//	TUNE_PERIOD, adjust the quantum from what the statistics say
+//	happened since the last adjustment:
+//
+//	  - a quantum a few times the mean CPU burst lets most bursts end
+//	    in one slice (if most were cut short, the mean is close to 
+//	    the quantum, and it grows);
+//	  - but a ready thread should not wait much longer than 
+//	    TUNE_RESPONSE_TIME for its turn, which with n threads ahead of
+//	    it on each CPU is n quanta;
+//	  - and the system time per context switch (an upper bound on what
+//	    one costs) should stay a small part of a slice.
+//
+//	The quantum moves half way to the result, within the -adaptive
+//	bounds.  Unless the timer is tickless, slices only end at timer 
+//	interrupts, so it is kept a multiple of TimerTicks.
+//----------------------------------------------------------------------
+
+void
+ProcessScheduler::StartTuning (void)
+{
+   nextTune = stats->totalTicks + TUNE_PERIOD;
+   tuneBursts = stats->cpu_burst_count;
+   tuneCPUTime = stats->cpu_time;
+   tuneSwitches = stats->preemptive_switch + stats->nonpreemptive_switch;
+   tuneSystemTicks = stats->systemTicks;
+   readySamples = readyTotal = 0;
+}
+
+void
+ProcessScheduler::TuneQuantum (void)
+{
+   int bursts, switches, target, limit, quantum;
+   double meanReady;
+
+   readySamples++;
+   readyTotal += listOfReadyThreads->NumReady();
+   if (stats->totalTicks < nextTune)
+      return;
+
+   bursts = stats->cpu_burst_count - tuneBursts;
+   if (bursts > 0)
+      target = TUNE_BURST_FACTOR * (stats->cpu_time - tuneCPUTime) / bursts;
+   else					// one burst ran the whole period
+      target = TUNE_BURST_FACTOR * schedQuantum;
+
+   meanReady = (double)readyTotal / readySamples;
+   limit = (int)(TUNE_RESPONSE_TIME / (1 + meanReady / numCPUs));
+   if (target > limit)
+      target = limit;
+
+   switches = stats->preemptive_switch + stats->nonpreemptive_switch - tuneSwitches;
+   if (switches > 0) {
+      limit = TUNE_OVERHEAD_FACTOR * (stats->systemTicks - tuneSystemTicks) / switches;
+      if (target < limit)
+         target = limit;
+   }
+
+   quantum = (schedQuantum + target) / 2;
+   if (!ticklessTimer)
+      quantum = ((quantum + TimerTicks / 2) / TimerTicks) * TimerTicks;
+   if (quantum < minSchedQuantum)
+      quantum = minSchedQuantum;
+   if (quantum > maxSchedQuantum)
+      quantum = maxSchedQuantum;
+
+   if (stats->quantumAdjustments == 0)
+      stats->minQuantum = stats->maxQuantum = schedQuantum;
+   if (quantum != schedQuantum) {
+      DEBUG('t', "Quantum %d -> %d (mean ready %.1f).\n", schedQuantum, quantum, meanReady);
+      schedQuantum = quantum;
+      stats->quantumAdjustments++;
+      if (quantum < stats->minQuantum)
+         stats->minQuantum = quantum;
+      if (quantum > stats->maxQuantum)
+         stats->maxQuantum = quantum;
+   }
+   stats->lastQuantum = schedQuantum;
+   StartTuning();
+}
+
+//----------------------------------------------------------------------
+// ProcessScheduler::Weight
+//      Return the CFS weight of "thread".  Its nice value (0 to 100) is
+//	mapped onto the Linux nice values (-20 to 19), whose weights go
+//	up by about 25% a step, 1024 at nice 0.
+//
+//	Under stride scheduling, return its tickets instead, which go up
+//	linearly as the nice value goes down (see STRIDE_TICKETS), so that
+//	the shares of the CPU the batch jobs get are easy to work out.
+//	The tickets lent to it are not included.
+//----------------------------------------------------------------------
+
+static int cfsWeights[40] = {
+ /* -20 */ 88761, 71755, 56483, 46273, 36291,
+ /* -15 */ 29154, 23254, 18705, 14949, 11916,
+ /* -10 */  9548,  7620,  6100,  4904,  3906,
+ /*  -5 */  3121,  2501,  1991,  1586,  1277,
+ /*   0 */  1024,   820,   655,   526,   423,
+ /*   5 */   335,   272,   215,   172,   137,
+ /*  10 */   110,    87,    70,    56,    45,
+ /*  15 */    36,    29,    23,    18,    15,
+};
+
+int
+ProcessScheduler::Weight (NachOSThread *thread)
+{
+   int nice = thread->GetBasePriority() - DEFAULT_BASE_PRIORITY;
+
+   if (nice < MIN_NICE_PRIORITY) nice = MIN_NICE_PRIORITY;
+   if (nice > MAX_NICE_PRIORITY) nice = MAX_NICE_PRIORITY;
+   if (schedulingAlgo == STRIDE_SCHED)
+      return STRIDE_TICKETS(nice);
+   return cfsWeights[((nice - MIN_NICE_PRIORITY) * 39) / (MAX_NICE_PRIORITY - MIN_NICE_PRIORITY)];
+}
+
+//----------------------------------------------------------------------
+// ProcessScheduler::ChargeVirtualRuntime
+//      "thread" has just run for "ticks": advance its virtual runtime by
+//	that, scaled by CFS_NICE_0_WEIGHT over its weight, carrying what
+//	the division rounds off to the next time.
+//
+//	Under stride scheduling this advances its pass by its stride (a 
+//	constant over its tickets, counting those lent to it) for each
+//	tick, so that the threads run in proportion to their tickets.
+//----------------------------------------------------------------------
+
+void
+ProcessScheduler::ChargeVirtualRuntime (NachOSThread *thread, int ticks)
+{
+   int weight = Weight(thread) + thread->GetLentTickets();
+   int scaled = ticks * CFS_NICE_0_WEIGHT + thread->GetVirtualRuntimeCarry();
+
+   thread->AddCPUTicks(ticks);
+   thread->SetVirtualRuntime(thread->GetVirtualRuntime() + scaled / weight,
+				scaled % weight);
+   UpdateMinVirtualRuntime();
+}
+
+//----------------------------------------------------------------------
+// ProcessScheduler::UpdateMinVirtualRuntime
+//      Move minVirtualRuntime up to the least virtual runtime of the
+//	running and ready threads, if that is larger.
+//----------------------------------------------------------------------
+
+void
+ProcessScheduler::UpdateMinVirtualRuntime (void)
+{
+   int least = -1, v;
+   bool found = FALSE;
+
+   if (!fairTree->IsEmpty()) {
+      least = fairTree->FirstKey();
+      found = TRUE;
+   }
+   for (int cpu = 0; cpu < numCPUs; cpu++) {
+      if (cpuThread[cpu] == NULL)
+         continue;
+      v = cpuThread[cpu]->GetVirtualRuntime();
+      if (!found || (v < least)) {
+         least = v;
+         found = TRUE;
+      }
+   }
+   if (found && (least > minVirtualRuntime))
+      minVirtualRuntime = least;
+}
+
+//----------------------------------------------------------------------
+// ProcessScheduler::RecordFairness
+//      Add the share of the CPU that exiting thread "thread" got while
+//	it was runnable, per unit of weight, to the CFS statistics.  Under
+//	a fair scheduler, threads that compete with each other all get the
+//	same share per unit of weight.
+//----------------------------------------------------------------------
+
+void
+ProcessScheduler::RecordFairness (NachOSThread *thread)
+{
+   int runnable = thread->GetCPUTicks() + thread->GetReadyTicks();
+   double share;
+
+   if ((excludeMainThread && (thread->GetPID() == 0)) || (thread->GetCPUTicks() == 0))
+      return;
+   share = ((double)thread->GetCPUTicks() / runnable) * CFS_NICE_0_WEIGHT / Weight(thread);
+   if ((stats->cfsShareThreads == 0) || (share < stats->cfsMinShare))
+      stats->cfsMinShare = share;
+   if ((stats->cfsShareThreads == 0) || (share > stats->cfsMaxShare))
+      stats->cfsMaxShare = share;
+   stats->cfsShareThreads++;
+}
+
+//----------------------------------------------------------------------
+// ProcessScheduler::QuantumUsed
+//      "thread" has just run for "ticks"; if that used up its time slice,
+//	move it down a queue (unless it is in the bottom one already).
+//----------------------------------------------------------------------
+
+void
+ProcessScheduler::QuantumUsed (NachOSThread *thread, int ticks)
+{
+   if (ticks < TimeSlice(thread))	// (this catches up on boosts)
+      return;
+   if (thread->GetLevel() < mlfqLevels - 1) {
+      thread->SetLevel(thread->GetLevel() + 1, boostEpoch);
+      stats->mlfqDemotions++;
+   }
+}
+
+//----------------------------------------------------------------------
+// ProcessScheduler::BoostPriorities
+//      Move every thread to the top MLFQ queue, so that the threads in
+//	the lower queues are not starved.  Only the ready threads, which
+//	are ordered by their queue, are moved now; the others catch up in
+//	CatchUpBoost before their queue is next looked at.
+//----------------------------------------------------------------------
+
+static void
+BoostReadyThread (int arg)
+{
+   scheduler->PriorityChanged((NachOSThread *)arg);
+}
+
+void
+ProcessScheduler::BoostPriorities (void)
+{
+   boostEpoch++;
+   nextBoost = stats->totalTicks + mlfqBoostPeriod;
+   stats->mlfqBoosts++;
+   listOfReadyThreads->Mapcar(BoostReadyThread);
+}
+
+//----------------------------------------------------------------------
+// ProcessScheduler::CatchUpBoost
+//      If there has been a boost since "thread" last changed queue, move
+//	it to the top queue.
+//----------------------------------------------------------------------
+
+void
+ProcessScheduler::CatchUpBoost (NachOSThread *thread)
+{
+   if (thread->GetBoostEpoch() != boostEpoch)
+      thread->SetLevel(0, boostEpoch);
+}
+
+//----------------------------------------------------------------------
+// ProcessScheduler::LendTickets
+//      "lender" is about to block until "borrower" exits: add its tickets
+//	(including any lent to it) to those of "borrower", which then runs
+//	as often as the two would have together.  The loan ends when 
+//	"borrower" exits, taking the tickets with it.
+//----------------------------------------------------------------------
+
+void
+ProcessScheduler::LendTickets (NachOSThread *lender, NachOSThread *borrower)
+{
+   ASSERT(borrower != NULL);
+   borrower->AddLentTickets(Weight(lender) + lender->GetLentTickets());
+   stats->strideLoans++;
+}
+
+//----------------------------------------------------------------------
+// ProcessScheduler::EndBurst
+//      "thread" has just run for "ticks", ending its CPU burst (under
+//	SRTF, adding the time it ran before being preempted).  Add the
+//	error of its estimate to the statistics, and estimate the next
+//	burst: by default, an exponential average of the bursts (with 
+//	weight ALPHA on this one); with -estimator 1, from the histogram
+//	of its past bursts (see NachOSThread::HistogramEstimate).
+//----------------------------------------------------------------------
+
+void
+ProcessScheduler::EndBurst (NachOSThread *thread, int ticks)
+{
+   int burst = ticks + thread->GetBurstRun();
+
+   thread->ResetBurstRun();
+   stats->burstEstimateError += abs(burst - thread->GetPriority());
+   if (burstEstimator == HISTOGRAM_ESTIMATOR) {
+      thread->RecordBurst(burst);
+      thread->SetPriority(thread->HistogramEstimate());
+   }
+   else
+      thread->SetPriority((int)(ALPHA*burst + (1-ALPHA)*thread->GetPriority()));
+}
+
+//----------------------------------------------------------------------
+// ProcessScheduler::RemainingEstimate
+//      Return how much of its estimated burst "thread" has left to run,
+//	counting the time it has been running on its CPU if it is running.
+//----------------------------------------------------------------------
+
+int
+ProcessScheduler::RemainingEstimate (NachOSThread *thread)
+{
+   int left = thread->GetPriority() - thread->GetBurstRun();
+
+   if (thread->getStatus() == RUNNING)
+      left -= stats->totalTicks - thread->GetCPUBurstStartTime();
+   return (left > 0) ? left : 0;
+}
+
+//----------------------------------------------------------------------
+// ProcessScheduler::PreemptIfShorter
+//      "thread" has just become ready.  If it is expected to finish its
+//	burst sooner than one of the running threads, preempt the running
+//	thread with the most left to run, once interrupts are next enabled
+//	(or, on another CPU, when that CPU next gets its turn).
+//----------------------------------------------------------------------
+
+void
+ProcessScheduler::PreemptIfShorter (NachOSThread *thread)
+{
+   int cpu, left, victim = -1, most = -1;
+
+   for (cpu = 0; cpu < numCPUs; cpu++) {
+      if ((cpuThread[cpu] == NULL) || (cpuThread[cpu]->getStatus() != RUNNING))
+         continue;
+      left = RemainingEstimate(cpuThread[cpu]);
+      if (left > most) {
+         most = left;
+         victim = cpu;
+      }
+   }
+   if ((victim == -1) || (RemainingEstimate(thread) >= most))
+      return;
+   stats->srtfPreemptions++;
+   if (victim == currentCPU)
+      interrupt->YieldSoon();
+   else
+      cpuPreempt[victim] = TRUE;
+}
+
+//----------------------------------------------------------------------
+// ProcessScheduler::SetRealTime
+//      Make "thread" a real-time thread, which runs for up to "budget"
+//	ticks in every "period" ticks, its first period starting now; or,
+//	if "period" is 0, an ordinary thread again.
+//
+//	A real-time thread with budget left is run ahead of the others,
+//	earliest deadline first, so as long as the real-time threads
+//	reserve no more than a CPU between them, each gets its budget in
+//	every period.  To keep it that way, a reservation that would take
+//	them over RT_MAX_UTILIZATION is refused (returning -1), and a 
+//	thread that uses up its budget runs as an ordinary thread until
+//	its next period (see NextPeriods).  Returns 0 if the reservation
+//	is made.
+//----------------------------------------------------------------------
+
+int
+ProcessScheduler::SetRealTime (NachOSThread *thread, int period, int budget)
+{
+   double share = 0, old = 0;
+
+   if ((period < 0) || ((period > 0) && ((budget <= 0) || (budget > period)))) {
+      stats->rtRejected++;
+      return -1;
+   }
+   if (period > 0)
+      share = (double)budget / period;
+   if (thread->IsRealTime())
+      old = (double)thread->GetBudget() / thread->GetPeriod();
+   if (rtUtilization - old + share > RT_MAX_UTILIZATION + 1e-9) {
+      stats->rtRejected++;
+      return -1;
+   }
+   rtUtilization += share - old;
+   (void) depletedTree->Remove(thread);	// it has a new budget, or none
+   thread->SetRealTime(period, budget, stats->totalTicks + period);
+   if (period > 0)
+      stats->rtAdmitted++;
+   return 0;
+}
+
+//----------------------------------------------------------------------
+// ProcessScheduler::ChargeRealTime
+//      Real-time thread "thread" has just run for "ticks": charge the 
+//	part of that in its current period to its budget.  If that uses
+//	it up, the thread waits for its next period in depletedTree.
+//----------------------------------------------------------------------
+
+void
+ProcessScheduler::ChargeRealTime (NachOSThread *thread, int ticks)
+{
+   int inPeriod = stats->totalTicks - (thread->GetDeadline() - thread->GetPeriod());
+   bool had = HasBudget(thread);
+
+   if (ticks > inPeriod)		// it became real-time mid-burst
+      ticks = inPeriod;
+   if (ticks > 0)
+      thread->AddBudgetUsed(ticks);
+   if (had && !HasBudget(thread)) {
+      stats->rtOverruns++;
+      depletedTree->Insert(thread, thread->GetDeadline());
+   }
+}
+
+//----------------------------------------------------------------------
+// ProcessScheduler::EndJob
+//      Real-time thread "thread" is about to block (usually in Sleep,
+//	until its next period), which ends its job for this period.  Count
+//	it as a deadline miss if it is done after the end of the period.
+//	Its next job starts when it wakes up.
+//----------------------------------------------------------------------
+
+void
+ProcessScheduler::EndJob (NachOSThread *thread)
+{
+   stats->rtJobs++;
+   if (stats->totalTicks > thread->GetDeadline())
+      stats->rtDeadlineMisses++;
+   (void) depletedTree->Remove(thread);
+}
+
+//----------------------------------------------------------------------
+// ProcessScheduler::NextPeriods
+//      Called from the timer interrupt handler.  Each real-time thread
+//	that used up its budget, and has reached the end of its period
+//	without blocking, did not get its job done in time: count it as a
+//	deadline miss, and start its next job, due at the end of the
+//	period now under way.  A ready thread moves back to realTimeTree,
+//	to run ahead of the ordinary threads again.
+//----------------------------------------------------------------------
+
+void
+ProcessScheduler::NextPeriods (void)
+{
+   NachOSThread *thread;
+   int periods;
+
+   while (!depletedTree->IsEmpty() && (depletedTree->FirstKey() <= stats->totalTicks)) {
+      thread = depletedTree->RemoveFirst();
+      stats->rtJobs++;
+      stats->rtDeadlineMisses++;
+      periods = (stats->totalTicks - thread->GetDeadline()) / thread->GetPeriod() + 1;
+      thread->StartJob(thread->GetDeadline() + periods * thread->GetPeriod());
+      if (thread->getStatus() != READY)
+         continue;			// running; it has budget again
+      if (!listOfReadyThreads->Remove(thread) && fairTree->Remove(thread))
+         readyWeight -= Weight(thread);
+      realTimeTree->Insert(thread, thread->GetDeadline());
+      PreemptForRealTime(thread);
+   }
+}
+
+//----------------------------------------------------------------------
+// ProcessScheduler::PreemptForRealTime
+//      Real-time thread "thread" has just become ready.  Unless a CPU is
+//	free for it, preempt an ordinary thread, or failing that, the 
+//	real-time thread with the latest deadline if that is later than
+//	"thread"'s -- once interrupts are next enabled (or, on another 
+//	CPU, when that CPU next gets its turn).
+//----------------------------------------------------------------------
+
+void
+ProcessScheduler::PreemptForRealTime (NachOSThread *thread)
+{
+   int cpu, victim = -1;
+   NachOSThread *running;
 
-   for (i=0; i<thread_index; i++) {
-      if ((i != currentPID) && !exitThreadArray[i]) {
-         ASSERT(threadArray[i] != NULL);
-         currentThreadUsage = threadArray[i]->GetUsage();
-         currentThreadUsage = currentThreadUsage >> 1;
-         currentThreadPriority = threadArray[i]->GetBasePriority() + (currentThreadUsage >> 1);
-         threadArray[i]->SetUsage(currentThreadUsage);
-         threadArray[i]->SetPriority(currentThreadPriority);
+   for (cpu = 0; cpu < numCPUs; cpu++) {
+      running = cpuThread[cpu];
+      if ((running == NULL) || (running->getStatus() != RUNNING))
+         return;			// it will get this CPU anyway
+      if (cpuPreempt[cpu])
+         continue;
+      if (!HasBudget(running)) {
+         victim = cpu;			// an ordinary thread; look no further
+         break;
       }
+      if ((running->GetDeadline() > thread->GetDeadline()) &&
+          ((victim == -1) || (running->GetDeadline() > cpuThread[victim]->GetDeadline())))
+         victim = cpu;
    }
+   if (victim == -1)
+      return;
+   stats->rtPreemptions++;
+   if (victim == currentCPU)
+      interrupt->YieldSoon();
+   else
+      cpuPreempt[victim] = TRUE;
 }
@@ -12,6 +12,8 @@
 #include "copyright.h"
 #include "list.h"
 #include "thread.h"
+#include "runqueue.h"
+#include "threadtree.h"
 
 // The following class defines the scheduler/dispatcher abstraction -- 
 // the data structures and operations needed to keep track of which 
@@ -30,15 +32,128 @@ class ProcessScheduler {
 
     void Tail();			// Used by fork()
 
+    // Used when there are several CPUs
+    void NextCPU();			// Give the next CPU its turn
+    bool ReleaseCPU();			// Leave this CPU idle, and carry on
+					// with another one, if any is busy
+
     void SetEmptyReadyQueueStartTime (int ticks);
 
     void UpdateThreadPriority (void);	// Used by the UNIX scheduler
+    void CatchUpUsage (NachOSThread *thread);
+					// Apply the decays it missed
+    unsigned GetDecayEpoch (void) { return decayEpoch; }
+    void PriorityChanged (NachOSThread *thread);
+					// Requeue a ready thread whose
+					// priority was changed
+
+    bool SlicesTime (NachOSThread *thread);
+					// Is "thread" preempted at the end
+					// of a time slice?
+    int TimeSlice (NachOSThread *thread);
+					// How long a slice "thread" gets
+
+    // Used by the round robin and UNIX schedulers, with -adaptive
+    void TuneQuantum (void);		// Called at each timer interrupt
+    int GetNextTune (void) { return nextTune; }
+
+    // Used for real-time threads, whatever the algorithm
+    int SetRealTime (NachOSThread *thread, int period, int budget);
+					// Reserve "budget" ticks of each 
+					// "period" for "thread", if possible
+    bool HasBudget (NachOSThread *thread)
+	{ return thread->IsRealTime() && (thread->GetBudgetUsed() < thread->GetBudget()); }
+    void ChargeRealTime (NachOSThread *thread, int ticks);
+					// "thread" ran for "ticks"
+    void EndJob (NachOSThread *thread);	// Its job for this period is done
+    void NextPeriods (void);		// Start the next jobs of the threads
+					// whose budgets ran out, at the end
+					// of their periods
+    int GetNextPeriod (void)		// When that is next due (-1: never)
+	{ return depletedTree->IsEmpty() ? -1 : depletedTree->FirstKey(); }
+
+    // Used by the SJF and SRTF schedulers
+    void EndBurst (NachOSThread *thread, int ticks);
+					// "thread" ran for "ticks", ending
+					// its CPU burst: estimate the next
+    int RemainingEstimate (NachOSThread *thread);
+					// What is left of its estimate
+
+    // Used by the completely fair scheduler, and by stride scheduling
+    // (where the virtual runtime is the pass)
+    void ChargeVirtualRuntime (NachOSThread *thread, int ticks);
+					// "thread" ran for "ticks"
+    int GetMinVirtualRuntime (void) { return minVirtualRuntime; }
+    void RecordFairness (NachOSThread *thread);
+					// Add an exiting thread's share of
+					// the CPU to the statistics
+    void LendTickets (NachOSThread *lender, NachOSThread *borrower);
+					// Add "lender"'s tickets to
+					// "borrower"'s (stride scheduling)
+
+    // Used by the MLFQ scheduler
+    void QuantumUsed (NachOSThread *thread, int ticks);
+					// Demote "thread" if it used up its
+					// time slice
+    void BoostPriorities (void);	// Move everyone to the top queue
+    int GetNextBoost (void) { return nextBoost; }
+    unsigned GetBoostEpoch (void) { return boostEpoch; }
+    void CatchUpBoost (NachOSThread *thread);
+					// Apply a boost it missed
+
+#ifdef USER_PROGRAM
+    void WriteCheckpoint(FILE *file);	// Save/restore the ready list
+    void ReadCheckpoint(FILE *file);	// (threads must exist already)
+#endif
    
   private:
-    List *listOfReadyThreads;  		// queue of threads that are ready to run,
+    void SwitchToCPU(int cpu);		// Carry on with the thread on "cpu"
+    void FillIdleCPUs();		// Dispatch ready threads to idle CPUs
+    void PreemptIfShorter(NachOSThread *thread);
+					// SRTF: make room for "thread"
+    void PreemptForRealTime(NachOSThread *thread);
+					// Make room for real-time "thread"
+
+    int ReadyKey(NachOSThread *thread);	// What the ready queue is 
+					// ordered by
+    bool NoneReady() 
+	{ return listOfReadyThreads->IsEmpty() && fairTree->IsEmpty() 
+		 && realTimeTree->IsEmpty(); }
+    int Weight(NachOSThread *thread);	// CFS weight, or tickets, from the
+					// nice value
+    void UpdateMinVirtualRuntime();
+    void StartTuning();			// Start a new TuneQuantum period
+
+    RunQueue *listOfReadyThreads;  	// queue of threads that are ready to run,
 				// but not running
+    ThreadTree *fairTree;		// the ready threads, by virtual
+					// runtime (or pass), under CFS (or 
+					// stride scheduling) instead
+    int minVirtualRuntime;		// never decreases; where threads that
+					// were away from the tree are put
+    int readyWeight;			// total weight of the threads in it
+    ThreadTree *realTimeTree;		// the ready real-time threads with
+					// budget left, by deadline; run
+					// ahead of the others
+    ThreadTree *depletedTree;		// the real-time threads that used
+					// up their budgets and are not
+					// blocked, by deadline
+    double rtUtilization;		// of a CPU, reserved by them
+
+    int nextTune;			// When the quantum is next adjusted;
+    int tuneBursts, tuneCPUTime;	// the statistics when it last was
+    int tuneSwitches, tuneSystemTicks;
+    int readySamples, readyTotal;	// ready threads at each interrupt
+					// since then
+
+    unsigned boostEpoch;		// How many MLFQ boosts there have been
+    int nextBoost;			// When the next one is due
 
     int empty_ready_queue_start_time;
+
+    unsigned decayEpoch;		// How many times the UNIX scheduler
+					// has decayed the usage of the
+					// threads
 };
 
 #endif // SCHEDULER_H
@@ -0,0 +1,188 @@
+// sleepqueue.cc
+//	Routines to manage the queue of sleeping threads, a binary heap
+//	of entries from a pool indexed by pid.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "sleepqueue.h"
+#include "system.h"
+
+//----------------------------------------------------------------------
+// SleepQueue::SleepQueue
+// 	Initialize an empty sleep queue, allocating an entry for each of
+//	the "maxThreads" pids.
+//----------------------------------------------------------------------
+
+SleepQueue::SleepQueue(int maxThreads)
+{
+    size = maxThreads;
+    pool = new SleepEntry[size];
+    heap = new SleepEntry*[size];
+    for (int i = 0; i < size; i++) {
+	pool[i].thread = NULL;
+	pool[i].index = -1;
+    }
+    numSleeping = 0;
+    nextOrder = 0;
+}
+
+SleepQueue::~SleepQueue()
+{
+    delete [] pool;
+    delete [] heap;
+}
+
+//----------------------------------------------------------------------
+// SleepQueue::Place, SleepQueue::SiftUp, SleepQueue::SiftDown
+// 	Keep the heap in order: move the entry at heap[i] up towards the
+//	root, or down towards the leaves, until it is after its parent
+//	and before its children.
+//----------------------------------------------------------------------
+
+void
+SleepQueue::Place(SleepEntry *entry, int i)
+{
+    heap[i] = entry;
+    entry->index = i;
+}
+
+void
+SleepQueue::SiftUp(int i)
+{
+    SleepEntry *entry = heap[i];
+    int parent;
+
+    while (i > 0) {
+	parent = (i - 1) / 2;
+	if (!Before(entry, heap[parent]))
+	    break;
+	Place(heap[parent], i);
+	i = parent;
+    }
+    Place(entry, i);
+}
+
+void
+SleepQueue::SiftDown(int i)
+{
+    SleepEntry *entry = heap[i];
+    int child;
+
+    while ((child = 2 * i + 1) < numSleeping) {
+	if ((child + 1 < numSleeping) && Before(heap[child + 1], heap[child]))
+	    child++;			// the earlier of the two children
+	if (!Before(heap[child], entry))
+	    break;
+	Place(heap[child], i);
+	i = child;
+    }
+    Place(entry, i);
+}
+
+//----------------------------------------------------------------------
+// SleepQueue::Insert
+// 	Put "thread" on the queue, to be woken up at time "when", after
+//	any others due at the same time.  It must not already be on it.
+//----------------------------------------------------------------------
+
+void
+SleepQueue::Insert(NachOSThread *thread, unsigned when)
+{
+    int pid = thread->GetPID();
+    SleepEntry *entry;
+
+    ASSERT((pid >= 0) && (pid < size));
+    entry = &pool[pid];
+    ASSERT(entry->thread == NULL);
+    entry->thread = thread;
+    entry->when = when;
+    entry->order = nextOrder++;
+    Place(entry, numSleeping++);
+    SiftUp(entry->index);
+}
+
+//----------------------------------------------------------------------
+// SleepQueue::Remove
+// 	Take "entry" out of the heap, and return it to the pool.
+//----------------------------------------------------------------------
+
+void
+SleepQueue::Remove(SleepEntry *entry)
+{
+    int i = entry->index;
+
+    ASSERT((i >= 0) && (i < numSleeping) && (heap[i] == entry));
+    entry->thread = NULL;
+    entry->index = -1;
+    if (i == --numSleeping)		// it was the last one
+	return;
+    Place(heap[numSleeping], i);	// move the last one into its place
+    SiftUp(i);
+    SiftDown(heap[i]->index);
+}
+
+//----------------------------------------------------------------------
+// SleepQueue::RemoveDue
+// 	If the first thread on the queue is due to wake up by time "now",
+//	take it off and return it; otherwise return NULL.  Call it until
+//	it returns NULL to wake up every thread that is due.
+//----------------------------------------------------------------------
+
+NachOSThread *
+SleepQueue::RemoveDue(unsigned now)
+{
+    NachOSThread *thread;
+
+    if ((numSleeping == 0) || (heap[0]->when > now))
+	return NULL;
+    thread = heap[0]->thread;
+    Remove(heap[0]);
+    return thread;
+}
+
+//----------------------------------------------------------------------
+// SleepQueue::Cancel
+// 	Take "thread" off the queue, if it is on it, so that it won't be
+//	woken up by the timer.  Returns TRUE if it was on the queue.
+//----------------------------------------------------------------------
+
+bool
+SleepQueue::Cancel(NachOSThread *thread)
+{
+    int pid = thread->GetPID();
+
+    if ((pid < 0) || (pid >= size) || (pool[pid].thread != thread))
+	return FALSE;
+    Remove(&pool[pid]);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// SleepQueue::Sorted
+// 	Fill in "threads" and "whens" with the sleeping threads and their
+//	wake up times, in the order they will wake up, leaving the queue
+//	as it was.  Returns the number of sleeping threads.
+//----------------------------------------------------------------------
+
+int
+SleepQueue::Sorted(NachOSThread **threads, unsigned *whens)
+{
+    SleepEntry **sorted = new SleepEntry*[numSleeping + 1], *entry;
+    int i, j;
+
+    for (i = 0; i < numSleeping; i++) {	// insertion sort
+	entry = heap[i];
+	for (j = i; (j > 0) && Before(entry, sorted[j - 1]); j--)
+	    sorted[j] = sorted[j - 1];
+	sorted[j] = entry;
+    }
+    for (i = 0; i < numSleeping; i++) {
+	threads[i] = sorted[i]->thread;
+	whens[i] = sorted[i]->when;
+    }
+    delete [] sorted;
+    return numSleeping;
+}
@@ -0,0 +1,78 @@
+// sleepqueue.h
+//	Data structures for the queue of sleeping threads, waiting for
+//	the timer to wake them up (see syscall_wrapper_Sleep, and the page
+//	fault handler, which sleeps while the page is "read in").
+//
+//	The queue is a binary heap ordered by wake up time, and then by
+//	the order the threads went to sleep in, so threads due at the same
+//	time wake up in the order they went to sleep.  The next wake up
+//	time is found in constant time; going to sleep, waking up and
+//	cancelling a sleep take O(log n) time.
+//
+//	A thread sleeps at most once at a time, so the entries are kept
+//	in a pool with one entry for each pid, allocated once.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef SLEEPQUEUE_H
+#define SLEEPQUEUE_H
+
+#include "copyright.h"
+#include "thread.h"
+
+// The following class defines an entry of the sleep queue.
+
+class SleepEntry {
+  public:
+    NachOSThread *thread;	// the sleeping thread (NULL if unused)
+    unsigned when;		// when to wake it up
+    unsigned order;		// breaks ties: the first to sleep wakes first
+    int index;			// where it is in the heap
+};
+
+// The following class defines the queue of sleeping threads, for
+// threads with pids less than "maxThreads".
+
+class SleepQueue {
+  public:
+    SleepQueue(int maxThreads);		// an empty queue
+    ~SleepQueue();
+
+    void Insert(NachOSThread *thread, unsigned when);
+					// put "thread" to sleep until "when"
+    NachOSThread *RemoveDue(unsigned now);
+					// take off a thread due to wake up
+					// by "now", NULL if none is
+    bool Cancel(NachOSThread *thread);	// take "thread" off, if it is on
+					// the queue (for an early wake up)
+
+    bool IsEmpty() { return (numSleeping == 0); }
+    int NumSleeping() { return numSleeping; }
+    unsigned NextWakeup() { return heap[0]->when; }
+					// when the first is due (the queue
+					// must not be empty)
+    int Sorted(NachOSThread **threads, unsigned *whens);
+					// list the sleepers in the order
+					// they will wake up; returns how
+					// many there are
+
+  private:
+    bool Before(SleepEntry *a, SleepEntry *b)
+	{ return (a->when < b->when)
+		 || ((a->when == b->when) && (a->order < b->order)); }
+    void Place(SleepEntry *entry, int i);	// put entry at heap[i]
+    void SiftUp(int i);
+    void SiftDown(int i);
+    void Remove(SleepEntry *entry);	// take it out of the heap
+
+    SleepEntry *pool;			// one entry for each pid
+    SleepEntry **heap;			// heap[0] wakes first; the children
+					// of heap[i] are heap[2i+1] and
+					// heap[2i+2]
+    int size, numSleeping;
+    unsigned nextOrder;			// to number the sleeps
+};
+
+#endif // SLEEPQUEUE_H
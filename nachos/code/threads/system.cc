@@ -20,19 +20,35 @@ Timer *timer;				// the hardware timer device,
 					// for invoking context switches
 
 unsigned numPagesAllocated;              // number of physical frames allocated
+unsigned numUsablePhysPages;		// frames user programs may use
 
 NachOSThread *threadArray[MAX_THREAD_COUNT];  // Array of thread pointers
 unsigned thread_index;			// Index into this array (also used to assign unique pid)
 bool initializedConsoleSemaphores;
 bool exitThreadArray[MAX_THREAD_COUNT];  //Marks exited threads
 
-TimeSortedWaitQueue *sleepQueueHead;	// Needed to implement syscall_wrapper_Sleep
+SleepQueue *sleepQueue;			// Needed to implement syscall_wrapper_Sleep
 
 int schedulingAlgo;			// Scheduling algorithm to simulate
 char **batchProcesses;			// Names of batch processes
 int *priority;				// Process priority
+int schedQuantum;			// Time slice of the preemptive algorithms
+bool adaptiveQuantum;			// Tune it (round robin and UNIX)
+int minSchedQuantum, maxSchedQuantum;	// between these bounds
+int mlfqLevels;				// Number of MLFQ queues
+int mlfqQuantum[MAX_MLFQ_LEVELS];	// Time slice of each of them
+int mlfqBoostPeriod;			// Time between MLFQ priority boosts
+int burstEstimator;			// How SJF and SRTF estimate bursts
+SchedTracer *schedTracer;		// Scheduling trace, if asked for
 
 int cpu_burst_start_time;        // Records the start of current CPU burst
+bool ticklessTimer;			// Only take timer interrupts when
+					// something is due
+
+int numCPUs;				// Number of simulated CPUs
+int currentCPU;				// The CPU currentThread runs on
+NachOSThread *cpuThread[MaxCPUs];	// The thread on each CPU
+bool cpuPreempt[MaxCPUs];		// Time slice expired on these CPUs
 int completionTimeArray[MAX_THREAD_COUNT];        // Records the completion time of all simulated threads
 bool excludeMainThread;		// Used by completion time statistics calculation
 
@@ -48,6 +64,9 @@ int physpage_LRU[NumPhysPages];
 int physpage_LRUclock[NumPhysPages];
 int LRUclockPointer = 0;
 
+int tlbReplaceAlgo;
+int *tlbentry_FIFO;
+
 
 #ifdef FILESYS_NEEDED
 FileSystem  *fileSystem;
@@ -59,6 +78,9 @@ SynchDisk   *synchDisk;
 
 #ifdef USER_PROGRAM	// requires either FILESYS or FILESYS_STUB
 Machine *machine;	// user program memory and registers
+UserProfiler *profiler;	// user program profiler, if asked for
+char *checkpointFile;	// where to write a checkpoint (-ckpt)
+int checkpointTime;	// when to write it
 #endif
 
 #ifdef NETWORK
@@ -90,23 +112,100 @@ extern void Cleanup();
 static void
 TimerInterruptHandler(int dummy)
 {
-    TimeSortedWaitQueue *ptr;
+    NachOSThread *sleeper;
     if (interrupt->getStatus() != IdleMode) {
-        // Check the head of the sleep queue
-        while ((sleepQueueHead != NULL) && (sleepQueueHead->GetWhen() <= (unsigned)stats->totalTicks)) {
-           sleepQueueHead->GetThread()->Schedule();
-           ptr = sleepQueueHead;
-           sleepQueueHead = sleepQueueHead->GetNext();
-           delete ptr;
-        }
+        // Wake up the sleepers that are due
+        while ((sleeper = sleepQueue->RemoveDue((unsigned)stats->totalTicks)) != NULL)
+           sleeper->Schedule();
+        // Give the real-time threads whose budgets ran out their next ones
+        if ((scheduler->GetNextPeriod() != -1) && (stats->totalTicks >= scheduler->GetNextPeriod()))
+           scheduler->NextPeriods();
         //printf("[%d] Timer interrupt.\n", stats->totalTicks);
-        if ((schedulingAlgo == ROUND_ROBIN) || (schedulingAlgo == UNIX_SCHED)) {
-           if ((stats->totalTicks - cpu_burst_start_time) >= SCHED_QUANTUM) {
-              ASSERT(cpu_burst_start_time == currentThread->GetCPUBurstStartTime());
-	      interrupt->YieldOnReturn();
+        if (scheduler->SlicesTime(currentThread)
+            && ((stats->totalTicks - cpu_burst_start_time) >= scheduler->TimeSlice(currentThread))) {
+           ASSERT(cpu_burst_start_time == currentThread->GetCPUBurstStartTime());
+	   interrupt->YieldOnReturn();
+           if (schedTracer != NULL)
+              schedTracer->Record(TRACE_EXPIRE, currentThread->GetPID(), currentCPU);
+        }
+        // The other CPUs yield when they next get their turn
+        for (int cpu = 0; cpu < numCPUs; cpu++) {
+           if ((cpu != currentCPU) && (cpuThread[cpu] != NULL) && scheduler->SlicesTime(cpuThread[cpu]) &&
+               ((stats->totalTicks - cpuThread[cpu]->GetCPUBurstStartTime()) >= scheduler->TimeSlice(cpuThread[cpu]))) {
+              cpuPreempt[cpu] = TRUE;
+              if (schedTracer != NULL)
+                 schedTracer->Record(TRACE_EXPIRE, cpuThread[cpu]->GetPID(), cpu);
            }
         }
+        if ((schedulingAlgo == MLFQ_SCHED) && (stats->totalTicks >= scheduler->GetNextBoost()))
+           scheduler->BoostPriorities();
+        if (adaptiveQuantum && ((schedulingAlgo == ROUND_ROBIN) || (schedulingAlgo == UNIX_SCHED)))
+           scheduler->TuneQuantum();
+#ifdef USER_PROGRAM
+        // Take the checkpoint asked for, once the interrupted thread is
+        // back in user code (see TakeCheckpoint for when it can't be taken)
+        if ((checkpointFile != NULL) && (stats->totalTicks >= checkpointTime))
+           interrupt->CheckpointOnReturn();
+#endif
     }
+    SetNextTimerInterrupt();
+}
+
+//----------------------------------------------------------------------
+// SetNextTimerInterrupt
+// 	With -tickless, program the timer to interrupt at the next time 
+//	the kernel has something to do: the earliest of the end of the 
+//	time slice (or real-time budget) of each busy CPU, the
+//	wake up time at the head of the sleep queue, the end of the period
+//	of the first real-time thread waiting for a new budget, the next 
+//	MLFQ priority boost, the next adjustment of the adaptive quantum,
+//	and the checkpoint time.  If there is nothing to do, the timer stays quiet.
+//
+//	Called whenever one of these changes: at the end of the timer
+//	interrupt handler, when a thread is dispatched or starts a new
+//	burst, and when a thread goes to sleep.
+//----------------------------------------------------------------------
+
+void
+SetNextTimerInterrupt()
+{
+    int when = -1, due;
+
+    if (!ticklessTimer)
+       return;
+    if (!sleepQueue->IsEmpty())
+       when = sleepQueue->NextWakeup();
+    for (int cpu = 0; cpu < numCPUs; cpu++) {
+       if ((cpuThread[cpu] == NULL) || cpuPreempt[cpu] || !scheduler->SlicesTime(cpuThread[cpu]))
+          continue;
+       due = cpuThread[cpu]->GetCPUBurstStartTime() + scheduler->TimeSlice(cpuThread[cpu]);
+       if (due <= stats->totalTicks)	// the handler has asked it to 
+          continue;			// yield already
+       if ((when == -1) || (due < when))
+          when = due;
+    }
+    due = scheduler->GetNextPeriod();
+    if ((due != -1) && ((when == -1) || (due < when)))
+       when = due;
+    if (schedulingAlgo == MLFQ_SCHED) {
+       due = scheduler->GetNextBoost();
+       if ((when == -1) || (due < when))
+          when = due;
+    }
+    if (adaptiveQuantum && ((schedulingAlgo == ROUND_ROBIN) || (schedulingAlgo == UNIX_SCHED))) {
+       due = scheduler->GetNextTune();
+       if ((when == -1) || (due < when))
+          when = due;
+    }
+#ifdef USER_PROGRAM
+    if (checkpointFile != NULL) {	// keep trying until it is taken
+       due = (checkpointTime > stats->totalTicks) ? checkpointTime 
+					: stats->totalTicks + TimerTicks;
+       if ((when == -1) || (due < when))
+          when = due;
+    }
+#endif
+    timer->SetAlarm(when);
 }
 
 //----------------------------------------------------------------------
@@ -128,8 +227,20 @@ Initialize(int argc, char **argv)
 
     initializedConsoleSemaphores = false;
     numPagesAllocated = 0;
+    numUsablePhysPages = NumPhysPages;
 
     schedulingAlgo = NON_PREEMPTIVE_BASE;	// Default
+    schedQuantum = DEFAULT_SCHED_QUANTUM;
+    adaptiveQuantum = FALSE;
+    mlfqLevels = DEFAULT_MLFQ_LEVELS;
+    mlfqBoostPeriod = DEFAULT_MLFQ_BOOST;
+    int mlfqFirstQuantum = 0;		// 0: the same as -q
+    char *traceFile = NULL;		// where to write the scheduling trace
+    int traceEvents = DEFAULT_SCHED_TRACE_EVENTS;
+    burstEstimator = EXP_AVERAGE_ESTIMATOR;
+    ticklessTimer = FALSE;
+    tlbReplaceAlgo = TLB_FIFO;			// Default
+    tlbentry_FIFO = NULL;
 
     batchProcesses = new char*[MAX_BATCH_SIZE];
     ASSERT(batchProcesses != NULL);
@@ -143,14 +254,30 @@ Initialize(int argc, char **argv)
     
     excludeMainThread = FALSE;
 
+    numCPUs = 1;
+    currentCPU = 0;
+    for (i=0; i<MaxCPUs; i++) { cpuThread[i] = NULL; cpuPreempt[i] = FALSE; }
+
     for (i=0; i<MAX_THREAD_COUNT; i++) { threadArray[i] = NULL; exitThreadArray[i] = false; completionTimeArray[i] = -1; }
     thread_index = 0;
 
-    sleepQueueHead = NULL;
+    sleepQueue = new SleepQueue(MAX_THREAD_COUNT);
 
+#ifdef USER_PROGRAM
+    checkpointFile = NULL;
+    checkpointTime = 0;
+#endif
 
 #ifdef USER_PROGRAM
     bool debugUserProg = FALSE;	// single step user program
+    bool blockMode = FALSE;	// run user programs a basic block at a time
+    bool batchTicks = FALSE;	// advance time in bulk between interrupts
+    int tlbEntries = 0;		// TLB size (0 for no TLB)
+    int tlbWays = 0;		// TLB associativity (0 for fully associative)
+    char *profileFile = NULL;	// where to write the profiles, if anywhere
+    int icacheArgs[4], dcacheArgs[4];	// cache geometry and policy
+    int missPenalty = 0;	// ticks charged for a cache miss
+    bool icache = FALSE, dcache = FALSE;
 #endif
 #ifdef FILESYS_NEEDED
     bool format = FALSE;	// format disk
@@ -169,6 +296,53 @@ Initialize(int argc, char **argv)
 	    	debugArgs = *(argv + 1);
 	    	argCount = 2;
 	    }
+	} else if (!strcmp(*argv, "-cpus")) {
+	    ASSERT(argc > 1);
+	    numCPUs = atoi(*(argv + 1));
+	    ASSERT((numCPUs >= 1) && (numCPUs <= MaxCPUs));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-q")) {
+	    ASSERT(argc > 1);
+	    schedQuantum = atoi(*(argv + 1));
+	    ASSERT(schedQuantum > 0);
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-adaptive")) {
+	    ASSERT(argc > 2);
+	    adaptiveQuantum = TRUE;
+	    minSchedQuantum = atoi(*(argv + 1));
+	    maxSchedQuantum = atoi(*(argv + 2));
+	    ASSERT((minSchedQuantum > 0) && (minSchedQuantum <= maxSchedQuantum));
+	    argCount = 3;
+	} else if (!strcmp(*argv, "-M")) {
+	    ASSERT(argc > 1);
+	    numUsablePhysPages = atoi(*(argv + 1));
+	    ASSERT((numUsablePhysPages > 0) && (numUsablePhysPages <= NumPhysPages));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-mlfq")) {
+	    ASSERT(argc > 2);
+	    mlfqLevels = atoi(*(argv + 1));
+	    mlfqFirstQuantum = atoi(*(argv + 2));
+	    ASSERT((mlfqLevels >= 1) && (mlfqLevels <= MAX_MLFQ_LEVELS));
+	    ASSERT(mlfqFirstQuantum > 0);
+	    argCount = 3;
+	} else if (!strcmp(*argv, "-boost")) {
+	    ASSERT(argc > 1);
+	    mlfqBoostPeriod = atoi(*(argv + 1));
+	    ASSERT(mlfqBoostPeriod > 0);
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-estimator")) {
+	    ASSERT(argc > 1);
+	    burstEstimator = atoi(*(argv + 1));
+	    ASSERT((burstEstimator >= EXP_AVERAGE_ESTIMATOR) && (burstEstimator <= HISTOGRAM_ESTIMATOR));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-trace")) {
+	    ASSERT(argc > 2);
+	    traceFile = *(argv + 1);
+	    traceEvents = atoi(*(argv + 2));
+	    ASSERT(traceEvents > 0);
+	    argCount = 3;
+	} else if (!strcmp(*argv, "-tickless")) {
+	    ticklessTimer = TRUE;
 	} else if (!strcmp(*argv, "-rs")) {
 	    ASSERT(argc > 1);
 	    RandomInit(atoi(*(argv + 1)));	// initialize pseudo-random
@@ -179,6 +353,50 @@ Initialize(int argc, char **argv)
 #ifdef USER_PROGRAM
 	if (!strcmp(*argv, "-s"))
 	    debugUserProg = TRUE;
+	if (!strcmp(*argv, "-bb"))
+	    blockMode = TRUE;
+	if (!strcmp(*argv, "-eh"))
+	    batchTicks = TRUE;
+	if (!strcmp(*argv, "-tlb")) {
+	    ASSERT(argc > 1);
+	    tlbEntries = atoi(*(argv + 1));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-tlbways")) {
+	    ASSERT(argc > 1);
+	    tlbWays = atoi(*(argv + 1));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-tlbrepl")) {
+	    ASSERT(argc > 1);
+	    tlbReplaceAlgo = atoi(*(argv + 1));
+	    ASSERT((tlbReplaceAlgo >= TLB_FIFO) && (tlbReplaceAlgo <= TLB_LRU));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-prof")) {
+	    ASSERT(argc > 1);
+	    profileFile = *(argv + 1);
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-icache")) {
+	    ASSERT(argc > 4);
+	    for (i = 0; i < 4; i++)
+		icacheArgs[i] = atoi(*(argv + i + 1));
+	    icache = TRUE;
+	    argCount = 5;
+	} else if (!strcmp(*argv, "-dcache")) {
+	    ASSERT(argc > 4);
+	    for (i = 0; i < 4; i++)
+		dcacheArgs[i] = atoi(*(argv + i + 1));
+	    dcache = TRUE;
+	    argCount = 5;
+	} else if (!strcmp(*argv, "-cachepenalty")) {
+	    ASSERT(argc > 1);
+	    missPenalty = atoi(*(argv + 1));
+	    ASSERT(missPenalty >= 0);
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-ckpt")) {
+	    ASSERT(argc > 2);
+	    checkpointFile = *(argv + 1);
+	    checkpointTime = atoi(*(argv + 2));
+	    argCount = 3;
+	}
 #endif
 #ifdef FILESYS_NEEDED
 	if (!strcmp(*argv, "-f"))
@@ -197,12 +415,19 @@ Initialize(int argc, char **argv)
 #endif
     }
 
+    // Each MLFQ queue has twice the time slice of the one above it
+    for (i = 0; i < mlfqLevels; i++)
+	mlfqQuantum[i] = ((mlfqFirstQuantum > 0) ? mlfqFirstQuantum : schedQuantum) << i;
+
     DebugInit(debugArgs);			// initialize DEBUG messages
     stats = new Statistics();			// collect statistics
+    schedTracer = NULL;
+    if (traceFile != NULL)
+	schedTracer = new SchedTracer(traceFile, traceEvents);
     interrupt = new Interrupt;			// start up interrupt handling
     scheduler = new ProcessScheduler();		// initialize the ready queue
     //if (randomYield)				// start the timer (if needed)
-       timer = new Timer(TimerInterruptHandler, 0, randomYield);
+       timer = new Timer(TimerInterruptHandler, 0, randomYield, ticklessTimer);
 
     threadToBeDestroyed = NULL;
 
@@ -212,6 +437,8 @@ Initialize(int argc, char **argv)
     currentThread = NULL;
     currentThread = new NachOSThread("main", MIN_NICE_PRIORITY);		
     currentThread->setStatus(RUNNING);
+    cpuThread[currentCPU] = currentThread;
+    stats->numCPUs = numCPUs;
     stats->start_time = stats->totalTicks;
     cpu_burst_start_time = stats->totalTicks;
 
@@ -219,7 +446,25 @@ Initialize(int argc, char **argv)
     CallOnUserAbort(Cleanup);			// if user hits ctl-C
     
 #ifdef USER_PROGRAM
-    machine = new Machine(debugUserProg);	// this must come first
+    machine = new Machine(debugUserProg, blockMode, batchTicks);
+						// this must come first
+    if (tlbEntries > 0)
+	machine->EnableTLB(tlbEntries, (tlbWays > 0) ? tlbWays : tlbEntries);
+    if (machine->tlb != NULL) {
+	tlbentry_FIFO = new int[machine->tlbSize];
+	for (i = 0; i < machine->tlbSize; i++)
+	    tlbentry_FIFO[i] = 0;
+    }
+    profiler = NULL;
+    if (profileFile != NULL)
+	profiler = new UserProfiler(profileFile);
+    if (icache)
+	machine->icache = new Cache("L1 I-cache", icacheArgs[0], icacheArgs[1],
+				    icacheArgs[2], icacheArgs[3]);
+    if (dcache)
+	machine->dcache = new Cache("L1 D-cache", dcacheArgs[0], dcacheArgs[1],
+				    dcacheArgs[2], dcacheArgs[3]);
+    machine->cacheMissPenalty = missPenalty;
 #endif
 
 #ifdef FILESYS
@@ -248,6 +493,7 @@ Cleanup()
 #endif
     
 #ifdef USER_PROGRAM
+    delete profiler;		// writes out the profiles still around
     delete machine;
 #endif
 
@@ -259,6 +505,7 @@ Cleanup()
     delete synchDisk;
 #endif
     
+    delete schedTracer;		// writes out the trace
     delete timer;
     delete scheduler;
     delete interrupt;
@@ -24,17 +24,50 @@
 #define NON_PREEMPTIVE_SJF 	2
 #define ROUND_ROBIN 		3
 #define UNIX_SCHED		4
-
-#define SCHED_QUANTUM		100		// If not a multiple of timer interval, quantum will overshoot
+#define CFS_SCHED		5	// Completely fair scheduler
+#define MLFQ_SCHED		6	// Multi-level feedback queue
+#define STRIDE_SCHED		7	// Stride (proportional share) scheduling
+#define SRTF_SCHED		8	// Shortest (estimated) remaining time first
+
+#define CFS_TARGET_LATENCY	400	// Time in which every runnable thread 
+					// should get a turn (CFS)
+#define CFS_MIN_GRANULARITY	50	// Shortest time slice (CFS)
+#define CFS_NICE_0_WEIGHT	1024	// Weight of a thread of (Linux) nice 0
+
+#define MAX_MLFQ_LEVELS		8	// Most queues MLFQ may have
+#define DEFAULT_MLFQ_LEVELS	3
+#define DEFAULT_MLFQ_BOOST	2000	// Time between priority boosts (MLFQ)
+
+#define STRIDE_TICKETS(nice)	(10 * (MAX_NICE_PRIORITY + 1 - (nice)))
+					// Tickets of a thread (stride
+					// scheduling): 1010 at nice 0, down
+					// to 10 at nice 100
+
+#define DEFAULT_SCHED_QUANTUM	100		// If not a multiple of timer interval, quantum will overshoot
+
+#define TUNE_PERIOD		1000	// Time between adjustments of the
+					// adaptive quantum (-adaptive)
+#define TUNE_BURST_FACTOR	2	// Aim for a quantum this many times
+					// the mean CPU burst
+#define TUNE_RESPONSE_TIME	1000	// Longest a ready thread should wait
+					// for its turn
+#define TUNE_OVERHEAD_FACTOR	10	// Keep the quantum this many times
+					// the cost of a context switch
 
 #define INITIAL_TAU		SystemTick	// Initial guess of the burst is set to the overhead of system activity
 #define ALPHA			0.5
 
+#define EXP_AVERAGE_ESTIMATOR	0	// How SJF and SRTF estimate the next
+#define HISTOGRAM_ESTIMATOR	1	// burst (see ProcessScheduler::EndBurst)
+
 #define MAX_NICE_PRIORITY	100		// Default nice value (used by UNIX scheduler)
 #define MIN_NICE_PRIORITY	0		// Highest input priority
 #define DEFAULT_BASE_PRIORITY	50		// Default base priority (used by UNIX scheduler)
 #define GET_NICE_FROM_PARENT	-1
 
+#define RT_MAX_UTILIZATION	0.9	// Most of a CPU the real-time threads
+					// may reserve between them
+
 // Initialization and cleanup routines
 extern void Initialize(int argc, char **argv); 	// Initialization,
 						// called before anything else
@@ -48,6 +81,7 @@ extern Interrupt *interrupt;			// interrupt status
 extern Statistics *stats;			// performance metrics
 extern Timer *timer;				// the hardware alarm clock
 extern unsigned numPagesAllocated;		// number of physical frames allocated
+extern unsigned numUsablePhysPages;		// frames user programs may use (-M)
 
 extern NachOSThread *threadArray[];  // Array of thread pointers
 extern unsigned thread_index;                  // Index into this array (also used to assign unique pid)
@@ -55,10 +89,27 @@ extern bool initializedConsoleSemaphores;	// Used to initialize the semaphores f
 extern bool exitThreadArray[];		// Marks exited threads
 
 extern int schedulingAlgo;		// Scheduling algorithm to simulate
+extern int schedQuantum;		// Time slice of the preemptive algorithms (-q)
+extern bool adaptiveQuantum;		// Tune it as the programs run (-adaptive)
+extern int minSchedQuantum;		// between these bounds
+extern int maxSchedQuantum;
+extern int mlfqLevels;			// Number of MLFQ queues (-mlfq)
+extern int mlfqQuantum[];		// Time slice of each of them
+extern int mlfqBoostPeriod;		// Time between MLFQ priority boosts (-boost)
+extern int burstEstimator;		// How SJF and SRTF estimate bursts (-estimator)
 extern char **batchProcesses;		// Names of batch executables
 extern int *priority;			// Process priority
 
 extern int cpu_burst_start_time;	// Records the start of current CPU burst
+extern bool ticklessTimer;		// Only take timer interrupts when
+					// something is due (-tickless)
+extern void SetNextTimerInterrupt();	// Tell the timer when that is
+
+extern int numCPUs;			// Number of simulated CPUs
+extern int currentCPU;			// The CPU currentThread runs on
+extern NachOSThread *cpuThread[];	// The thread on each CPU (NULL if idle)
+extern bool cpuPreempt[];		// CPUs whose thread must yield when
+					// it next gets its turn
 extern int completionTimeArray[];	// Records the completion time of all simulated threads
 extern bool excludeMainThread;		// Used by completion time statistics calculation
 
@@ -77,29 +128,29 @@ extern int LRUclockPointer;
 
 extern int pageReplaceAlgo;
 
+// TLB replacement policies (used when running with a TLB)
+#define TLB_FIFO		0
+#define TLB_RANDOM		1
+#define TLB_LRU			2
+
+extern int tlbReplaceAlgo;		// TLB replacement policy
+extern int *tlbentry_FIFO;		// When each TLB entry was filled
 
 
-class TimeSortedWaitQueue {		// Needed to implement syscall_wrapper_Sleep
-private:
-   NachOSThread *t;				// NachOSThread pointer of the sleeping thread
-   unsigned when;			// When to wake up
-   TimeSortedWaitQueue *next;		// Build the list
 
-public:
-   TimeSortedWaitQueue (NachOSThread *th,unsigned w) { t = th; when = w; next = NULL; }
-   ~TimeSortedWaitQueue (void) {}
-   
-   NachOSThread *GetThread (void) { return t; }
-   unsigned GetWhen (void) { return when; }
-   TimeSortedWaitQueue *GetNext(void) { return next; }
-   void SetNext (TimeSortedWaitQueue *n) { next = n; }
-};
+#include "sleepqueue.h"
+extern SleepQueue *sleepQueue;		// Needed to implement syscall_wrapper_Sleep
 
-extern TimeSortedWaitQueue *sleepQueueHead;
+#include "schedtrace.h"
+extern SchedTracer *schedTracer;	// Scheduling trace (-trace), or NULL
 
 #ifdef USER_PROGRAM
 #include "machine.h"
+#include "profile.h"
 extern Machine* machine;	// user program memory and registers
+extern UserProfiler *profiler;	// user program profiler, if asked for
+extern char *checkpointFile;	// where to write a checkpoint (-ckpt)
+extern int checkpointTime;	// when to write it
 #endif
 
 #ifdef FILESYS_NEEDED 		// FILESYS or FILESYS_STUB 
@@ -62,6 +62,7 @@ NachOSThread::NachOSThread(char* threadName, int nice)
     for (i=0; i<MAX_CHILD_COUNT; i++) exitedChild[i] = false;
 
     instructionCount = 0;
+    trap = NO_TRAP;
 
     if (nice == GET_NICE_FROM_PARENT) {
        if (ppid != -1) {
@@ -76,8 +77,20 @@ NachOSThread::NachOSThread(char* threadName, int nice)
     }
     schedPriority = basePriority;
     usage = 0;
-
-    if (schedulingAlgo == NON_PREEMPTIVE_SJF) schedPriority = INITIAL_TAU;
+    decayEpoch = (scheduler != NULL) ? scheduler->GetDecayEpoch() : 0;
+    vruntime = (scheduler != NULL) ? scheduler->GetMinVirtualRuntime() : 0;
+    vruntimeCarry = 0;
+    cpuTicks = readyTicks = 0;
+    lentTickets = 0;
+    rtPeriod = rtBudget = rtDeadline = rtUsed = 0;
+    burstRun = 0;
+    for (i = 0; i < BURST_HISTOGRAM_BUCKETS; i++)
+       burstCount[i] = burstTotal[i] = 0;
+    numBursts = 0;
+    mlfqLevel = 0;
+    boostEpoch = (scheduler != NULL) ? scheduler->GetBoostEpoch() : 0;
+
+    if ((schedulingAlgo == NON_PREEMPTIVE_SJF) || (schedulingAlgo == SRTF_SCHED)) schedPriority = INITIAL_TAU;
 }
 
 //----------------------------------------------------------------------
@@ -97,6 +110,7 @@ NachOSThread::~NachOSThread()
     DEBUG('t', "Deleting thread \"%s\"\n", name);
 
     ASSERT(this != currentThread);
+    (void) sleepQueue->Cancel(this);	// in case it is still asleep
     if (stack != NULL)
 	DeallocBoundedArray((char *) stack, StackSize * sizeof(int));
 }
@@ -248,17 +262,31 @@ NachOSThread::Exit (bool terminateSim, int exitcode)
           if ((stats->totalTicks - cpu_burst_start_time) < stats->min_cpu_burst) {
              stats->min_cpu_burst = (stats->totalTicks - cpu_burst_start_time);
           }
+          if (IsRealTime()) {
+             scheduler->ChargeRealTime(this, stats->totalTicks - cpu_burst_start_time);
+          }
           if (schedulingAlgo == UNIX_SCHED) {
              scheduler->UpdateThreadPriority();
           }
-          else if (schedulingAlgo == NON_PREEMPTIVE_SJF) {
-             stats->burstEstimateError += abs(stats->totalTicks - cpu_burst_start_time - schedPriority);
-             schedPriority = (int)(ALPHA*(stats->totalTicks - cpu_burst_start_time) + (1-ALPHA)*schedPriority);
+          else if ((schedulingAlgo == NON_PREEMPTIVE_SJF) || (schedulingAlgo == SRTF_SCHED)) {
+             scheduler->EndBurst(this, stats->totalTicks - cpu_burst_start_time);
+          }
+          else if ((schedulingAlgo == CFS_SCHED) || (schedulingAlgo == STRIDE_SCHED)) {
+             scheduler->ChargeVirtualRuntime(this, stats->totalTicks - cpu_burst_start_time);
           }
        }
     }
+    if (IsRealTime()) {
+       scheduler->EndJob(this);
+       (void) scheduler->SetRealTime(this, 0, 0);	// free its reservation
+    }
     status = BLOCKED;
     completionTimeArray[currentThread->GetPID()] = stats->totalTicks;
+    if (schedTracer != NULL)
+       schedTracer->Record(TRACE_EXIT, pid, currentCPU);
+    if ((schedulingAlgo == CFS_SCHED) || (schedulingAlgo == STRIDE_SCHED)) {
+       scheduler->RecordFairness(this);
+    }
 
     // Set exit code in parent's structure provided the parent hasn't exited
     if (ppid != -1) {
@@ -271,6 +299,8 @@ NachOSThread::Exit (bool terminateSim, int exitcode)
     nextThread = scheduler->SelectNextReadyThread();
     if (nextThread == NULL) {
        scheduler->SetEmptyReadyQueueStartTime(stats->totalTicks);
+       if (!terminateSim && scheduler->ReleaseCPU())
+          ASSERT(FALSE);	// another CPU deletes us, we never get back
     }
     while (nextThread == NULL) {
        if (terminateSim) {
@@ -334,10 +364,23 @@ NachOSThread::YieldCPU ()
           if ((stats->totalTicks - cpu_burst_start_time) < stats->min_cpu_burst) {
              stats->min_cpu_burst = (stats->totalTicks - cpu_burst_start_time);
           }
-          ASSERT(schedulingAlgo != NON_PREEMPTIVE_SJF);
+          if (IsRealTime()) {
+             scheduler->ChargeRealTime(this, stats->totalTicks - cpu_burst_start_time);
+          }
+          ASSERT((schedulingAlgo != NON_PREEMPTIVE_SJF) || IsRealTime());
+          if ((schedulingAlgo == CFS_SCHED) || (schedulingAlgo == STRIDE_SCHED)) {
+             scheduler->ChargeVirtualRuntime(this, stats->totalTicks - cpu_burst_start_time);
+          }
+          else if (schedulingAlgo == MLFQ_SCHED) {
+             scheduler->QuantumUsed(this, stats->totalTicks - cpu_burst_start_time);
+          }
+          else if (schedulingAlgo == SRTF_SCHED) {
+             burstRun += stats->totalTicks - cpu_burst_start_time;
+          }
        }
        cpu_burst_start_time = stats->totalTicks;
        SetCPUBurstStartTime(cpu_burst_start_time);
+       SetNextTimerInterrupt();
     }
     (void) interrupt->SetLevel(oldLevel);
 }
@@ -382,19 +425,34 @@ NachOSThread::PutThreadToSleep ()
           if ((stats->totalTicks - cpu_burst_start_time) < stats->min_cpu_burst) {
              stats->min_cpu_burst = (stats->totalTicks - cpu_burst_start_time);
           }
+          if (IsRealTime()) {
+             scheduler->ChargeRealTime(this, stats->totalTicks - cpu_burst_start_time);
+          }
           if (schedulingAlgo == UNIX_SCHED) {
              scheduler->UpdateThreadPriority();
           }
-          else if (schedulingAlgo == NON_PREEMPTIVE_SJF) {
-             stats->burstEstimateError += abs(stats->totalTicks - cpu_burst_start_time - schedPriority);
-             schedPriority = (int)(ALPHA*(stats->totalTicks - cpu_burst_start_time) + (1-ALPHA)*schedPriority);
+          else if ((schedulingAlgo == NON_PREEMPTIVE_SJF) || (schedulingAlgo == SRTF_SCHED)) {
+             scheduler->EndBurst(this, stats->totalTicks - cpu_burst_start_time);
+          }
+          else if ((schedulingAlgo == CFS_SCHED) || (schedulingAlgo == STRIDE_SCHED)) {
+             scheduler->ChargeVirtualRuntime(this, stats->totalTicks - cpu_burst_start_time);
+          }
+          else if (schedulingAlgo == MLFQ_SCHED) {
+             scheduler->QuantumUsed(this, stats->totalTicks - cpu_burst_start_time);
           }
        }
     }
+    if ((status == RUNNING) && IsRealTime()) {
+       scheduler->EndJob(this);		// it waits for its next period
+    }
     status = BLOCKED;
+    if (schedTracer != NULL)
+       schedTracer->Record(TRACE_SLEEP, pid, currentCPU);
     nextThread = scheduler->SelectNextReadyThread();
     if (nextThread == NULL) {
        scheduler->SetEmptyReadyQueueStartTime (stats->totalTicks);
+       if (scheduler->ReleaseCPU())
+          return;		// another CPU ran until we were dispatched again
     }
     while (nextThread == NULL) {
 	interrupt->Idle();	// no one to run, wait for an interrupt
@@ -464,6 +522,8 @@ NachOSThread::CreateThreadStack (VoidFunctionPtr func, int arg)
 
 #ifdef USER_PROGRAM
 #include "machine.h"
+#include "syscall.h"
+#include "checkpoint.h"
 
 //----------------------------------------------------------------------
 // NachOSThread::SaveUserState
@@ -500,6 +560,131 @@ NachOSThread::RestoreUserState()
 	machine->WriteRegister(i, userRegisters[i]);
     stateRestored = true;
 }
+
+//----------------------------------------------------------------------
+// NachOSThread::WriteCheckpoint
+//	Save the state of the thread to a checkpoint file.  The user
+//	registers must have been saved (SaveUserState); the address space
+//	is saved separately.
+//----------------------------------------------------------------------
+
+void
+NachOSThread::WriteCheckpoint(FILE *file)
+{
+    int length = strlen(name);
+
+    CheckpointWrite(file, &length, sizeof(length));
+    CheckpointWrite(file, name, length);
+    CheckpointWrite(file, &pid, sizeof(pid));
+    CheckpointWrite(file, &ppid, sizeof(ppid));
+    CheckpointWrite(file, &status, sizeof(status));
+    CheckpointWrite(file, childpidArray, sizeof(childpidArray));
+    CheckpointWrite(file, childexitcode, sizeof(childexitcode));
+    CheckpointWrite(file, exitedChild, sizeof(exitedChild));
+    CheckpointWrite(file, &childcount, sizeof(childcount));
+    CheckpointWrite(file, &waitchild_id, sizeof(waitchild_id));
+    CheckpointWrite(file, &wait_start_time, sizeof(wait_start_time));
+    CheckpointWrite(file, &burst_start_time, sizeof(burst_start_time));
+    scheduler->CatchUpUsage(this);	// so that the epoch needn't be saved
+    CheckpointWrite(file, &basePriority, sizeof(basePriority));
+    CheckpointWrite(file, &schedPriority, sizeof(schedPriority));
+    CheckpointWrite(file, &usage, sizeof(usage));
+    CheckpointWrite(file, &vruntime, sizeof(vruntime));
+    CheckpointWrite(file, &vruntimeCarry, sizeof(vruntimeCarry));
+    CheckpointWrite(file, &cpuTicks, sizeof(cpuTicks));
+    CheckpointWrite(file, &readyTicks, sizeof(readyTicks));
+    CheckpointWrite(file, &burstRun, sizeof(burstRun));
+    CheckpointWrite(file, burstCount, sizeof(burstCount));
+    CheckpointWrite(file, burstTotal, sizeof(burstTotal));
+    CheckpointWrite(file, &numBursts, sizeof(numBursts));
+    CheckpointWrite(file, &rtPeriod, sizeof(rtPeriod));
+    CheckpointWrite(file, &rtBudget, sizeof(rtBudget));
+    CheckpointWrite(file, &rtDeadline, sizeof(rtDeadline));
+    CheckpointWrite(file, &rtUsed, sizeof(rtUsed));
+    scheduler->CatchUpBoost(this);
+    CheckpointWrite(file, &mlfqLevel, sizeof(mlfqLevel));
+    CheckpointWrite(file, &instructionCount, sizeof(instructionCount));
+    CheckpointWrite(file, &trap, sizeof(trap));
+    CheckpointWrite(file, userRegisters, sizeof(userRegisters));
+}
+
+//----------------------------------------------------------------------
+// NachOSThread::ReadCheckpoint
+//	Restore the state saved by WriteCheckpoint, including the pid.
+//	The thread's stack is set up separately, to start afresh.
+//----------------------------------------------------------------------
+
+void
+NachOSThread::ReadCheckpoint(FILE *file)
+{
+    int length;
+
+    CheckpointRead(file, &length, sizeof(length));
+    ASSERT((length >= 0) && (length < 1024));
+    CheckpointRead(file, name, length);
+    name[length] = '\0';
+    CheckpointRead(file, &pid, sizeof(pid));
+    CheckpointRead(file, &ppid, sizeof(ppid));
+    CheckpointRead(file, &status, sizeof(status));
+    CheckpointRead(file, childpidArray, sizeof(childpidArray));
+    CheckpointRead(file, childexitcode, sizeof(childexitcode));
+    CheckpointRead(file, exitedChild, sizeof(exitedChild));
+    CheckpointRead(file, &childcount, sizeof(childcount));
+    CheckpointRead(file, &waitchild_id, sizeof(waitchild_id));
+    CheckpointRead(file, &wait_start_time, sizeof(wait_start_time));
+    CheckpointRead(file, &burst_start_time, sizeof(burst_start_time));
+    CheckpointRead(file, &basePriority, sizeof(basePriority));
+    CheckpointRead(file, &schedPriority, sizeof(schedPriority));
+    CheckpointRead(file, &usage, sizeof(usage));
+    CheckpointRead(file, &vruntime, sizeof(vruntime));
+    CheckpointRead(file, &vruntimeCarry, sizeof(vruntimeCarry));
+    CheckpointRead(file, &cpuTicks, sizeof(cpuTicks));
+    CheckpointRead(file, &readyTicks, sizeof(readyTicks));
+    CheckpointRead(file, &burstRun, sizeof(burstRun));
+    CheckpointRead(file, burstCount, sizeof(burstCount));
+    CheckpointRead(file, burstTotal, sizeof(burstTotal));
+    CheckpointRead(file, &numBursts, sizeof(numBursts));
+    CheckpointRead(file, &rtPeriod, sizeof(rtPeriod));
+    CheckpointRead(file, &rtBudget, sizeof(rtBudget));
+    CheckpointRead(file, &rtDeadline, sizeof(rtDeadline));
+    CheckpointRead(file, &rtUsed, sizeof(rtUsed));
+    CheckpointRead(file, &mlfqLevel, sizeof(mlfqLevel));
+    boostEpoch = scheduler->GetBoostEpoch();
+    decayEpoch = scheduler->GetDecayEpoch();
+    CheckpointRead(file, &instructionCount, sizeof(instructionCount));
+    CheckpointRead(file, &trap, sizeof(trap));
+    CheckpointRead(file, userRegisters, sizeof(userRegisters));
+    stateRestored = false;
+}
+
+//----------------------------------------------------------------------
+// NachOSThread::FinishTrap
+//	Called when a thread restored from a checkpoint first runs, with
+//	its user registers loaded, to finish what it was doing in the 
+//	kernel when the checkpoint was taken.  A thread that was running
+//	user code, or was stopped in a page fault (the instruction will 
+//	be retried), has nothing to finish.
+//----------------------------------------------------------------------
+
+void
+NachOSThread::FinishTrap()
+{
+    switch (trap) {
+      case SysCall_Join:
+	machine->WriteRegister(2, 
+		JoinWithChild(CheckIfChild(machine->ReadRegister(4))));
+	// fall through, to advance the program counters
+      case SysCall_Yield:
+      case SysCall_Sleep:
+	machine->WriteRegister(PrevPCReg, machine->ReadRegister(PCReg));
+	machine->WriteRegister(PCReg, machine->ReadRegister(NextPCReg));
+	machine->WriteRegister(NextPCReg, machine->ReadRegister(NextPCReg)+4);
+	break;
+      default:
+	break;
+    }
+    trap = NO_TRAP;
+}
 #endif
 
 //----------------------------------------------------------------------
@@ -526,6 +711,10 @@ NachOSThread::CheckIfChild (int childpid)
 // NachOSThread::JoinWithChild
 //      Called by a thread as a result of syscall_wrapper_Join.
 //      Returns the exit code of the child being joined with.
+//
+//	Under stride scheduling, the thread lends its tickets to the child
+//	while it waits, so that the child, which it is waiting for, gets
+//	its share of the CPU as well.  The loan ends when the child exits.
 //----------------------------------------------------------------------
 
 int
@@ -536,6 +725,9 @@ NachOSThread::JoinWithChild (int whichchild)
       // Put myself to sleep
       waitchild_id = whichchild;
       IntStatus oldLevel = interrupt->SetLevel(IntOff);
+      if (schedulingAlgo == STRIDE_SCHED) {
+         scheduler->LendTickets(this, threadArray[childpidArray[whichchild]]);
+      }
       printf("[pid %d] Before sleep in JoinWithChild.\n", pid);
       PutThreadToSleep();
       printf("[pid %d] After sleep in JoinWithChild.\n", pid);
@@ -558,6 +750,59 @@ NachOSThread::ResetReturnValue ()
 }
 #endif
 
+//----------------------------------------------------------------------
+// NachOSThread::RecordBurst
+//      Add a CPU burst of "ticks" to the histogram of the thread's past
+//	bursts, which has a bucket for each power of two.  Once it holds
+//	BURST_HISTORY bursts, the counts are halved, so that old bursts
+//	count for less than recent ones.
+//----------------------------------------------------------------------
+
+void
+NachOSThread::RecordBurst (int ticks)
+{
+   int b, halved;
+
+   for (b = 0; (b < BURST_HISTOGRAM_BUCKETS - 1) && ((ticks >> (b + 1)) > 0); b++)
+      ;
+   burstCount[b]++;
+   burstTotal[b] += ticks;
+   if (++numBursts < BURST_HISTORY)
+      return;
+   numBursts = 0;
+   for (b = 0; b < BURST_HISTOGRAM_BUCKETS; b++) {
+      if (burstCount[b] == 0)
+         continue;
+      halved = burstCount[b] / 2;
+      burstTotal[b] = (int)(((double)burstTotal[b] * halved) / burstCount[b]);
+      burstCount[b] = halved;
+      numBursts += halved;
+   }
+}
+
+//----------------------------------------------------------------------
+// NachOSThread::HistogramEstimate
+//      Estimate the length of the next CPU burst: the median of the 
+//	past bursts in the histogram, taken as the mean length of those 
+//	in its bucket.  Unlike an average, this isn't thrown off by the
+//	odd very long or very short burst.
+//----------------------------------------------------------------------
+
+int
+NachOSThread::HistogramEstimate (void)
+{
+   int b, seen = 0;
+
+   if (numBursts == 0)
+      return schedPriority;		// no history; keep the estimate
+   for (b = 0; b < BURST_HISTOGRAM_BUCKETS; b++) {
+      seen += burstCount[b];
+      if (2 * seen > numBursts)
+         break;
+   }
+   return burstTotal[b] / burstCount[b];
+}
+
 //----------------------------------------------------------------------
 // NachOSThread::Schedule
 //      Enqueues the thread in the ready queue.
@@ -591,40 +836,10 @@ NachOSThread::Startup()
 void
 NachOSThread::SortedInsertInWaitQueue (unsigned when)
 {
-   TimeSortedWaitQueue *ptr, *prev, *temp;
-
-   if (sleepQueueHead == NULL) {
-      sleepQueueHead = new TimeSortedWaitQueue (this, when);
-      ASSERT(sleepQueueHead != NULL);
-   }
-   else {
-      ptr = sleepQueueHead;
-      prev = NULL;
-      while ((ptr != NULL) && (ptr->GetWhen() <= when)) {
-         prev = ptr;
-         ptr = ptr->GetNext();
-      }
-      if (ptr == NULL) {  // Insert at tail
-         ptr = new TimeSortedWaitQueue (this, when);
-         ASSERT(ptr != NULL);
-         ASSERT(prev->GetNext() == NULL);
-         prev->SetNext(ptr);
-      }
-      else if (prev == NULL) {  // Insert at head
-         ptr = new TimeSortedWaitQueue (this, when);
-         ASSERT(ptr != NULL);
-         ptr->SetNext(sleepQueueHead);
-         sleepQueueHead = ptr;
-      }
-      else {
-         temp = new TimeSortedWaitQueue (this, when);
-         ASSERT(temp != NULL);
-         temp->SetNext(ptr);
-         prev->SetNext(temp);
-      }
-   }
+   sleepQueue->Insert(this, when);
 
    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+   SetNextTimerInterrupt();		// we may be the next to wake up
    //printf("[pid %d] Going to sleep at %d.\n", pid, stats->totalTicks);
    PutThreadToSleep();
    //printf("[pid %d] Returned from sleep at %d.\n", pid, stats->totalTicks);
@@ -38,6 +38,10 @@
 #define THREAD_H
 
 #define MAX_CHILD_COUNT 100
+#define BURST_HISTOGRAM_BUCKETS	16	// Powers of two, for the histogram
+					// burst estimator
+#define BURST_HISTORY		32	// Bursts in the histogram before the
+					// counts are halved
 
 #include "copyright.h"
 #include "utility.h"
@@ -57,6 +61,11 @@
 // WATCH OUT IF THIS ISN'T BIG ENOUGH!!!!!
 #define StackSize	(4 * 1024)	// in words
 
+// What a thread is doing in the kernel, on behalf of its user program
+// (see NachOSThread::SetTrap).  Otherwise, the system call number.
+#define NO_TRAP		-1		// nothing; it is running user code
+#define FAULT_TRAP	-2		// handling an exception
+
 
 // NachOSThread state
 enum ThreadStatus { JUST_CREATED, RUNNING, READY, BLOCKED };
@@ -152,6 +161,48 @@ class NachOSThread {
     void SetUsage (int usage);
     int GetUsage (void);
 
+    void SetDecayEpoch (unsigned e) { decayEpoch = e; }
+    unsigned GetDecayEpoch (void) { return decayEpoch; }
+
+    // Used by the completely fair scheduler
+    void SetVirtualRuntime (int v, int carry) { vruntime = v; vruntimeCarry = carry; }
+    int GetVirtualRuntime (void) { return vruntime; }
+    int GetVirtualRuntimeCarry (void) { return vruntimeCarry; }
+    void AddCPUTicks (int ticks) { cpuTicks += ticks; }
+    int GetCPUTicks (void) { return cpuTicks; }
+    void AddReadyTicks (int ticks) { readyTicks += ticks; }
+    int GetReadyTicks (void) { return readyTicks; }
+
+    // Used by stride scheduling
+    void AddLentTickets (int t) { lentTickets += t; }
+    int GetLentTickets (void) { return lentTickets; }
+
+    // Used by the MLFQ scheduler
+    void SetLevel (int l, unsigned epoch) { mlfqLevel = l; boostEpoch = epoch; }
+    int GetLevel (void) { return mlfqLevel; }
+    unsigned GetBoostEpoch (void) { return boostEpoch; }
+
+    // Used by the SJF and SRTF schedulers
+    void AddBurstRun (int ticks) { burstRun += ticks; }
+    int GetBurstRun (void) { return burstRun; }
+    void ResetBurstRun (void) { burstRun = 0; }
+    void RecordBurst (int ticks);	// Add a burst to the histogram
+    int HistogramEstimate (void);	// Estimate the next one from it
+
+    // Used for real-time threads
+    void SetRealTime (int period, int budget, int deadline)
+	{ rtPeriod = period; rtBudget = budget; rtDeadline = deadline; rtUsed = 0; }
+    bool IsRealTime (void) { return (rtPeriod > 0); }
+    int GetPeriod (void) { return rtPeriod; }
+    int GetBudget (void) { return rtBudget; }
+    int GetDeadline (void) { return rtDeadline; }
+    void StartJob (int deadline) { rtDeadline = deadline; rtUsed = 0; }
+    void AddBudgetUsed (int ticks) { rtUsed += ticks; }
+    int GetBudgetUsed (void) { return rtUsed; }
+
+    void SetTrap (int t) { trap = t; }	// Called by ExceptionHandler
+    int GetTrap (void) { return trap; }
+
   private:
     // some of the private data for this class is listed above
     
@@ -176,9 +227,32 @@ class NachOSThread {
 
     int basePriority, schedPriority, usage;	// Used by the UNIX scheduler
 						// schedPriority is also used to store the next burst estimate
+    unsigned decayEpoch;		// Usage is decayed up to this epoch
+					// (see ProcessScheduler::CatchUpUsage)
+    int vruntime;			// CPU time, weighted by nice value (CFS)
+    int vruntimeCarry;			// what the weighting rounded off
+    int cpuTicks, readyTicks;		// Time spent running, and ready to run
+    int lentTickets;			// Lent by the threads joining it (not
+					// checkpointed: a restored join lends
+					// them again)
+    int burstRun;			// Time run in the current burst before
+					// being preempted (SRTF)
+    int burstCount[BURST_HISTOGRAM_BUCKETS];	// Past bursts of 2^i to
+    int burstTotal[BURST_HISTOGRAM_BUCKETS];	// 2^(i+1)-1 ticks, and their
+    int numBursts;				// total length
+    int rtPeriod, rtBudget;		// Real-time reservation (period 0 if
+					// it is not a real-time thread)
+    int rtDeadline;			// End of the period of the current job
+    int rtUsed;				// Budget it has used in it
+    int mlfqLevel;			// MLFQ queue, 0 the top one
+    unsigned boostEpoch;		// The last boost it has had (see
+					// ProcessScheduler::CatchUpBoost)
 
     unsigned instructionCount;          // Keeps track of the instruction count executed by this thread
 
+    int trap;				// The outermost exception or system
+					// call being handled for this thread
+
 #ifdef USER_PROGRAM
 // A thread running a user program actually has *two* sets of CPU registers -- 
 // one for its state while executing user code, one for its state 
@@ -191,6 +265,12 @@ class NachOSThread {
     void SaveUserState();		// save user-level register state
     void RestoreUserState();		// restore user-level register state
 
+    void WriteCheckpoint(FILE *file);	// save/restore this thread's
+    void ReadCheckpoint(FILE *file);	// state, and user registers
+    void FinishTrap();			// finish what the thread was doing
+					// in the kernel, if anything, once
+					// restored from a checkpoint
+
     ProcessAddressSpace *space;			// User code this thread is running.
 #endif
 };
@@ -0,0 +1,260 @@
+// threadtree.cc
+//	Routines to manage a balanced (AVL) search tree of threads, with
+//	nodes from a pool indexed by pid.
+//
+//	In an AVL tree, the heights of the two subtrees of every node
+//	differ by at most one; a rotation or two on the way back up from
+//	an insert or remove restores that.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "threadtree.h"
+#include "system.h"
+
+//----------------------------------------------------------------------
+// ThreadTree::ThreadTree
+// 	Initialize an empty tree, allocating a node for each of the
+//	"maxThreads" pids.
+//----------------------------------------------------------------------
+
+ThreadTree::ThreadTree(int maxThreads)
+{
+    size = maxThreads;
+    pool = new ThreadTreeNode[size];
+    for (int i = 0; i < size; i++)
+	pool[i].thread = NULL;
+    root = first = NULL;
+    numThreads = 0;
+    nextOrder = 0;
+}
+
+ThreadTree::~ThreadTree()
+{
+    delete [] pool;
+}
+
+//----------------------------------------------------------------------
+// ThreadTree::FixHeight, ThreadTree::RotateLeft, ThreadTree::RotateRight,
+// ThreadTree::Balance
+// 	Keep the tree balanced.  Balance returns the new root of the
+//	subtree rooted at "node", whose subtrees are balanced, and whose
+//	heights differ by at most two.
+//----------------------------------------------------------------------
+
+void
+ThreadTree::FixHeight(ThreadTreeNode *node)
+{
+    int left = Height(node->left), right = Height(node->right);
+
+    node->height = ((left > right) ? left : right) + 1;
+}
+
+ThreadTreeNode *
+ThreadTree::RotateLeft(ThreadTreeNode *node)
+{
+    ThreadTreeNode *up = node->right;
+
+    node->right = up->left;
+    up->left = node;
+    FixHeight(node);
+    FixHeight(up);
+    return up;
+}
+
+ThreadTreeNode *
+ThreadTree::RotateRight(ThreadTreeNode *node)
+{
+    ThreadTreeNode *up = node->left;
+
+    node->left = up->right;
+    up->right = node;
+    FixHeight(node);
+    FixHeight(up);
+    return up;
+}
+
+ThreadTreeNode *
+ThreadTree::Balance(ThreadTreeNode *node)
+{
+    FixHeight(node);
+    if (Height(node->right) - Height(node->left) == 2) {
+	if (Height(node->right->left) > Height(node->right->right))
+	    node->right = RotateRight(node->right);
+	return RotateLeft(node);
+    }
+    if (Height(node->left) - Height(node->right) == 2) {
+	if (Height(node->left->right) > Height(node->left->left))
+	    node->left = RotateLeft(node->left);
+	return RotateRight(node);
+    }
+    return node;
+}
+
+//----------------------------------------------------------------------
+// ThreadTree::InsertAt, ThreadTree::RemoveAt, ThreadTree::RemoveMin
+// 	Insert or remove "item" in the subtree rooted at "node", returning
+//	the new root of the subtree.  RemoveMin removes the first node of
+//	the subtree, returning it in "*min".
+//----------------------------------------------------------------------
+
+ThreadTreeNode *
+ThreadTree::InsertAt(ThreadTreeNode *node, ThreadTreeNode *item)
+{
+    if (node == NULL)
+	return item;
+    if (Before(item, node))
+	node->left = InsertAt(node->left, item);
+    else
+	node->right = InsertAt(node->right, item);
+    return Balance(node);
+}
+
+ThreadTreeNode *
+ThreadTree::RemoveMin(ThreadTreeNode *node, ThreadTreeNode **min)
+{
+    if (node->left == NULL) {
+	*min = node;
+	return node->right;
+    }
+    node->left = RemoveMin(node->left, min);
+    return Balance(node);
+}
+
+ThreadTreeNode *
+ThreadTree::RemoveAt(ThreadTreeNode *node, ThreadTreeNode *item)
+{
+    ThreadTreeNode *next;
+
+    ASSERT(node != NULL);
+    if (node == item) {			// replace it with the next in order
+	if (node->right == NULL)
+	    return node->left;
+	node->right = RemoveMin(node->right, &next);
+	next->left = node->left;
+	next->right = node->right;
+	return Balance(next);
+    }
+    if (Before(item, node))
+	node->left = RemoveAt(node->left, item);
+    else
+	node->right = RemoveAt(node->right, item);
+    return Balance(node);
+}
+
+//----------------------------------------------------------------------
+// ThreadTree::FindFirst
+// 	Remember which node is first, after the tree has changed.
+//----------------------------------------------------------------------
+
+void
+ThreadTree::FindFirst()
+{
+    first = root;
+    if (first != NULL)
+	while (first->left != NULL)
+	    first = first->left;
+}
+
+//----------------------------------------------------------------------
+// ThreadTree::Insert
+// 	Put "thread" in the tree, with key "key", after any others with
+//	the same key.  It must not already be in the tree.
+//----------------------------------------------------------------------
+
+void
+ThreadTree::Insert(NachOSThread *thread, int key)
+{
+    int pid = thread->GetPID();
+    ThreadTreeNode *item;
+
+    ASSERT((pid >= 0) && (pid < size));
+    item = &pool[pid];
+    ASSERT(item->thread == NULL);
+    item->thread = thread;
+    item->key = key;
+    item->order = nextOrder++;
+    item->left = item->right = NULL;
+    item->height = 1;
+    root = InsertAt(root, item);
+    if ((first == NULL) || Before(item, first))
+	first = item;
+    numThreads++;
+}
+
+//----------------------------------------------------------------------
+// ThreadTree::Remove
+// 	Take "thread" out of the tree, if it is in it.  Returns TRUE if it
+//	was.
+//----------------------------------------------------------------------
+
+bool
+ThreadTree::Remove(NachOSThread *thread)
+{
+    int pid = thread->GetPID();
+
+    if ((pid < 0) || (pid >= size) || (pool[pid].thread != thread))
+	return FALSE;
+    root = RemoveAt(root, &pool[pid]);
+    pool[pid].thread = NULL;
+    FindFirst();
+    numThreads--;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// ThreadTree::RemoveFirst
+// 	Take out and return the thread with the smallest key, the first
+//	inserted of those with that key.  Returns NULL if the tree is empty.
+//----------------------------------------------------------------------
+
+NachOSThread *
+ThreadTree::RemoveFirst()
+{
+    NachOSThread *thread;
+
+    if (first == NULL)
+	return NULL;
+    thread = first->thread;
+    (void) Remove(thread);
+    return thread;
+}
+
+//----------------------------------------------------------------------
+// ThreadTree::LastKey
+// 	Return the largest key in the tree, which must not be empty.
+//----------------------------------------------------------------------
+
+int
+ThreadTree::LastKey()
+{
+    ThreadTreeNode *node = root;
+
+    ASSERT(node != NULL);
+    while (node->right != NULL)
+	node = node->right;
+    return node->key;
+}
+
+//----------------------------------------------------------------------
+// ThreadTree::Mapcar
+// 	Apply "func" to each thread in the tree, in order.
+//----------------------------------------------------------------------
+
+void
+ThreadTree::MapcarAt(ThreadTreeNode *node, VoidFunctionPtr func)
+{
+    if (node == NULL)
+	return;
+    MapcarAt(node->left, func);
+    (*func)((int) node->thread);
+    MapcarAt(node->right, func);
+}
+
+void
+ThreadTree::Mapcar(VoidFunctionPtr func)
+{
+    MapcarAt(root, func);
+}
@@ -0,0 +1,80 @@
+// threadtree.h
+//	Data structures for a balanced search tree of threads, ordered by
+//	a key -- used by the schedulers that run the ready thread with the
+//	smallest key, when the keys are too spread out for the buckets of
+//	the RunQueue (the completely fair scheduler orders the threads by
+//	virtual runtime).
+//
+//	Threads with the same key are ordered by when they were inserted,
+//	the first inserted first.  The tree is an AVL tree, so inserting
+//	and removing take O(log n) time; the first thread is remembered,
+//	so finding it takes constant time.
+//
+//	The nodes are kept in a pool with one node for each pid.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef THREADTREE_H
+#define THREADTREE_H
+
+#include "copyright.h"
+#include "thread.h"
+
+// The following class defines a node of the tree.
+
+class ThreadTreeNode {
+  public:
+    NachOSThread *thread;	// the thread (NULL if unused)
+    int key;			// what the tree is ordered by
+    unsigned order;		// breaks ties: the first inserted first
+    ThreadTreeNode *left, *right;
+    int height;			// of the subtree rooted here
+};
+
+// The following class defines the tree, for threads with pids less than
+// "maxThreads".
+
+class ThreadTree {
+  public:
+    ThreadTree(int maxThreads);		// an empty tree
+    ~ThreadTree();
+
+    void Insert(NachOSThread *thread, int key);
+					// put "thread" in, with key "key"
+    NachOSThread *RemoveFirst();	// take out the thread with the
+					// smallest key (NULL if none)
+    bool Remove(NachOSThread *thread);	// take "thread" out, if it is in
+
+    bool IsEmpty() { return (root == NULL); }
+    int NumThreads() { return numThreads; }
+    NachOSThread *First()		// the thread with the smallest key
+	{ return (first != NULL) ? first->thread : NULL; }
+    int FirstKey() { return first->key; }	// the smallest and largest
+    int LastKey();				// keys (must not be empty)
+    void Mapcar(VoidFunctionPtr func);	// apply "func" to each thread, in
+					// order
+
+  private:
+    bool Before(ThreadTreeNode *a, ThreadTreeNode *b)
+	{ return (a->key < b->key)
+		 || ((a->key == b->key) && (a->order < b->order)); }
+    int Height(ThreadTreeNode *node) { return (node == NULL) ? 0 : node->height; }
+    void FixHeight(ThreadTreeNode *node);
+    ThreadTreeNode *RotateLeft(ThreadTreeNode *node);
+    ThreadTreeNode *RotateRight(ThreadTreeNode *node);
+    ThreadTreeNode *Balance(ThreadTreeNode *node);
+    ThreadTreeNode *InsertAt(ThreadTreeNode *node, ThreadTreeNode *item);
+    ThreadTreeNode *RemoveAt(ThreadTreeNode *node, ThreadTreeNode *item);
+    ThreadTreeNode *RemoveMin(ThreadTreeNode *node, ThreadTreeNode **min);
+    void MapcarAt(ThreadTreeNode *node, VoidFunctionPtr func);
+    void FindFirst();			// set "first"
+
+    ThreadTreeNode *pool;		// one node for each pid
+    ThreadTreeNode *root, *first;
+    int size, numThreads;
+    unsigned nextOrder;			// to number the inserts
+};
+
+#endif // THREADTREE_H
@@ -19,6 +19,7 @@
 #include "system.h"
 #include "addrspace.h"
 #include "noff.h"
+#include "checkpoint.h"
 
 //----------------------------------------------------------------------
 // SwapHeader
@@ -65,6 +66,7 @@ ProcessAddressSpace::ProcessAddressSpace(OpenFile *executable)
     TranslationEntry *entry;
     unsigned int pageFrame;
 
+    execFile = NULL;			// the caller may fill it in
     executable->ReadAt((char *)&noffH, sizeof(noffH), 0);
     if ((noffH.noffMagic != NOFFMAGIC) && 
 		(WordToHost(noffH.noffMagic) == NOFFMAGIC))
@@ -78,7 +80,7 @@ ProcessAddressSpace::ProcessAddressSpace(OpenFile *executable)
     numVirtualPages = divRoundUp(size, PageSize);
     size = numVirtualPages * PageSize;
 
-    ASSERT(numVirtualPages+numPagesAllocated <= NumPhysPages);		// check we're not trying
+    ASSERT(numVirtualPages+numPagesAllocated <= numUsablePhysPages);		// check we're not trying
 										// to run anything too big --
 										// at least until we have
 										// virtual memory
@@ -181,9 +183,9 @@ ProcessAddressSpace::ProcessAddressSpace(char* file){
 
 ProcessAddressSpace::ProcessAddressSpace(ProcessAddressSpace *parentSpace)
 {
+    execFile = parentSpace->execFile;
     if(pageReplaceAlgo > 0)
     {
-        execFile = parentSpace->execFile;
         Executable = fileSystem->Open(execFile);
         // printf("%s\n", );
     }
@@ -192,7 +194,7 @@ ProcessAddressSpace::ProcessAddressSpace(ProcessAddressSpace *parentSpace)
     unsigned i, size = numVirtualPages * PageSize;
     unsigned count = 0;
 
-    ASSERT(numVirtualPages+numPagesAllocated <= NumPhysPages);                // check we're not trying to run anything too big -
+    ASSERT(numVirtualPages+numPagesAllocated <= numUsablePhysPages);                // check we're not trying to run anything too big -
 
     DEBUG('a', "Initializing address space, num pages %d, size %d\n",
                                         numVirtualPages, size);
@@ -232,6 +234,9 @@ ProcessAddressSpace::ProcessAddressSpace(ProcessAddressSpace *parentSpace)
     for (i=0; i<size; i++) {
        machine->mainMemory[startAddrChild+i] = machine->mainMemory[startAddrParent+i];
     }
+    for (i=0; i<numVirtualPages; i++) {
+       machine->InvalidateDecodedPage(numPagesAllocated+i);
+    }
 
     // numPagesAllocated += numVirtualPages;
     numPagesAllocated += count;
@@ -333,14 +338,67 @@ void ProcessAddressSpace::manageChildParentTable(ProcessAddressSpace *parentSpac
 
 
 //----------------------------------------------------------------------
-// ProcessAddressSpace::~ProcessAddressSpace
-// 	Dealloate an address space.  Nothing for now!
+// ProcessAddressSpace::ProcessAddressSpace (FILE *)
+//      Read back an address space saved by WriteCheckpoint.  Its pages
+//      are already in main memory (restored as a whole).
 //----------------------------------------------------------------------
 
+ProcessAddressSpace::ProcessAddressSpace(FILE *checkpoint)
+{
+    int length;
+    unsigned backupSize;
 
+    CheckpointRead(checkpoint, &numVirtualPages, sizeof(numVirtualPages));
+    KernelPageTable = new TranslationEntry[numVirtualPages];
+    CheckpointRead(checkpoint, KernelPageTable, 
+			numVirtualPages * sizeof(TranslationEntry));
+    backup = new char[numVirtualPages * PageSize];
+    CheckpointRead(checkpoint, &backupSize, sizeof(backupSize));
+    CheckpointRead(checkpoint, backup, backupSize);
+
+    CheckpointRead(checkpoint, &length, sizeof(length));
+    execFile = NULL;
+    Executable = NULL;
+    if (length > 0) {
+        execFile = new char[length + 1];
+        CheckpointRead(checkpoint, execFile, length);
+        execFile[length] = '\0';
+        if (pageReplaceAlgo > 0)
+            Executable = fileSystem->Open(execFile);   // to demand page from
+    }
+}
 
+//----------------------------------------------------------------------
+// ProcessAddressSpace::WriteCheckpoint
+//      Save the page table and backing store to a checkpoint file, for
+//      ProcessAddressSpace(FILE *) to read back.  Shared pages, which
+//      come last, are never backed up, and may have no backing store.
+//----------------------------------------------------------------------
 
+void
+ProcessAddressSpace::WriteCheckpoint(FILE *checkpoint)
+{
+    int length = (execFile != NULL) ? strlen(execFile) : 0;
+    unsigned backupSize;
+
+    FlushTLB(-1);		// bring the use and dirty bits up to date
+    CheckpointWrite(checkpoint, &numVirtualPages, sizeof(numVirtualPages));
+    CheckpointWrite(checkpoint, KernelPageTable, 
+			numVirtualPages * sizeof(TranslationEntry));
+    for (backupSize = 0; (backupSize < numVirtualPages) 
+		&& !KernelPageTable[backupSize].shared; backupSize++)
+        ;
+    backupSize *= PageSize;
+    CheckpointWrite(checkpoint, &backupSize, sizeof(backupSize));
+    CheckpointWrite(checkpoint, backup, backupSize);
+    CheckpointWrite(checkpoint, &length, sizeof(length));
+    CheckpointWrite(checkpoint, execFile, length);
+}
 
+//----------------------------------------------------------------------
+// ProcessAddressSpace::~ProcessAddressSpace
+// 	Dealloate an address space.  Nothing for now!
+//----------------------------------------------------------------------
 
 ProcessAddressSpace::~ProcessAddressSpace()
 {
@@ -359,7 +417,9 @@ void ProcessAddressSpace::cleanPages(){
         }
     }
    }
+   machine->FlushSoftTLB();
    delete KernelPageTable;
+   KernelPageTable = NULL;
    if(Executable == NULL)return;
    if(pageReplaceAlgo>0)delete Executable;    
 }
@@ -401,24 +461,106 @@ ProcessAddressSpace::InitUserModeCPURegisters()
 // 	On a context switch, save any machine state, specific
 //	to this address space, that needs saving.
 //
-//	For now, nothing!
+//	If there is a TLB, save the use and dirty bits it collected
+//	into the page table.
 //----------------------------------------------------------------------
 
 void ProcessAddressSpace::SaveContextOnSwitch() 
-{}
+{
+    FlushTLB(-1);
+}
 
 //----------------------------------------------------------------------
 // ProcessAddressSpace::RestoreContextOnSwitch
 // 	On a context switch, restore the machine state so that
 //	this address space can run.
 //
-//      For now, tell the machine where to find the page table.
+//      Tell the machine where to find the page table, and empty the
+//	TLB (if any), which holds the previous address space's pages.
 //----------------------------------------------------------------------
 
 void ProcessAddressSpace::RestoreContextOnSwitch() 
 {
     machine->KernelPageTable = KernelPageTable;
     machine->KernelPageTableSize = numVirtualPages;
+    machine->FlushSoftTLB();
+    if (machine->tlb != NULL)
+	for (int i = 0; i < machine->tlbSize; i++)
+	    machine->tlb[i].valid = FALSE;
+}
+
+//----------------------------------------------------------------------
+// ProcessAddressSpace::RefillTLB
+// 	Handle a TLB miss: load the translation of "vaddr" into the TLB,
+//	replacing an entry of its set chosen by tlbReplaceAlgo if the
+//	set is full.
+//
+//	Returns FALSE, without touching the TLB, if the page is not in
+//	memory (a real page fault).
+//----------------------------------------------------------------------
+
+bool ProcessAddressSpace::RefillTLB(unsigned vaddr)
+{
+    unsigned vpn = vaddr / PageSize;
+    int ways = machine->tlbWays;
+    int first = (vpn % (machine->tlbSize / ways)) * ways;
+    int victim = -1, i;
+
+    if ((vpn >= numVirtualPages) || !KernelPageTable[vpn].valid)
+        return FALSE;
+
+    for (i = first; i < first + ways; i++) {
+        if (!machine->tlb[i].valid) {
+            victim = i;
+            break;
+        }
+    }
+    if (victim == -1) {			// set is full, replace someone
+        if (tlbReplaceAlgo == TLB_RANDOM)
+            victim = first + Random() % ways;
+        else {
+            int *when = (tlbReplaceAlgo == TLB_LRU) ? machine->tlbLastUse 
+                                                    : tlbentry_FIFO;
+            victim = first;
+            for (i = first + 1; i < first + ways; i++)
+                if (when[i] < when[victim])
+                    victim = i;
+        }
+        FlushTLB(machine->tlb[victim].virtualPage);
+    }
+
+    machine->tlb[victim] = KernelPageTable[vpn];
+    tlbentry_FIFO[victim] = stats->totalTicks;
+    machine->tlbLastUse[victim] = stats->totalTicks;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// ProcessAddressSpace::FlushTLB
+// 	Copy the use and dirty bits of the TLB entries for page "vpn"
+//	(or for every page, if "vpn" is -1) back into the page table,
+//	and drop the entries from the TLB.  The kernel must do this before
+//	looking at those bits, or changing the translation of the page.
+//----------------------------------------------------------------------
+
+void ProcessAddressSpace::FlushTLB(int vpn)
+{
+    TranslationEntry *entry;
+
+    if (machine->tlb == NULL)
+        return;
+    for (int i = 0; i < machine->tlbSize; i++) {
+        entry = &machine->tlb[i];
+        if (!entry->valid || ((vpn != -1) && (entry->virtualPage != vpn)))
+            continue;
+        if (KernelPageTable != NULL) {
+            if (entry->use)
+                KernelPageTable[entry->virtualPage].use = TRUE;
+            if (entry->dirty)
+                KernelPageTable[entry->virtualPage].dirty = TRUE;
+        }
+        entry->valid = FALSE;
+    }
 }
 
 unsigned
@@ -437,6 +579,7 @@ unsigned
 ProcessAddressSpace::AllocateSharedMemory(unsigned int size){
     unsigned int num_shared_pages = divRoundUp(size, PageSize);
     unsigned int i, prev_numVirtualPages = numVirtualPages;
+    FlushTLB(-1);       // bring the page table up to date before copying it
     numVirtualPages += num_shared_pages;
 
     TranslationEntry* newKernelPageTable = new TranslationEntry[numVirtualPages];
@@ -467,6 +610,7 @@ ProcessAddressSpace::AllocateSharedMemory(unsigned int size){
         physpage_owner[newKernelPageTable[i].physicalPage] = currentThread;
         physpage_shared[newKernelPageTable[i].physicalPage] = TRUE;
         vpn_of_physpage[newKernelPageTable[i].physicalPage] = i;
+        machine->InvalidateDecodedPage(newKernelPageTable[i].physicalPage);
 
     }
 
@@ -524,13 +668,20 @@ bool ProcessAddressSpace::DemandPageAllocation(unsigned BadVAddr){
 int replace_with_next_physpage(int parent_physpage)
 {
     if(pageReplaceAlgo == 0)
+    {
+        ASSERT(numPagesAllocated < numUsablePhysPages);
+        machine->InvalidateDecodedPage(numPagesAllocated);
         return numPagesAllocated++;
+    }
     
     else{
-    for(int i=0;i<NumPhysPages;i++)
+    for(int i=0;i<(int)numUsablePhysPages;i++)
     {
         if(pid_of_physpage[i] == -1)
+        {
+            machine->InvalidateDecodedPage(i);
             return i;
+        }
     }
     }
     // Page fault will occur now
@@ -548,6 +699,8 @@ int replace_with_next_physpage(int parent_physpage)
 
     if(physpage_shared[page_val] == FALSE)
     {
+        if(threadArray[pid] == currentThread)   // get the TLB's dirty bit
+            currentThread->space->FlushTLB(vpn);
         if(threadArray[pid]->space->KernelPageTable[vpn].dirty == TRUE)
         {
             // need to backup
@@ -558,13 +711,15 @@ int replace_with_next_physpage(int parent_physpage)
             }
         }
         threadArray[pid]->space->KernelPageTable[vpn].valid = FALSE;
+        machine->FlushSoftTLB();
         pid_of_physpage[page_val] = -1;
         physpage_owner[page_val] = NULL;
         vpn_of_physpage[page_val] = -1;
 
         physpage_LRUclock[page_val] = 1;
         physpage_LRU[page_val] = stats->totalTicks;
-        
+
+        machine->InvalidateDecodedPage(page_val);
         return page_val;
     }
     return -1;
@@ -572,16 +727,16 @@ int replace_with_next_physpage(int parent_physpage)
 
 int get_random_physpage(int parent_physpage)
 {
-    int page_val = Random()%NumPhysPages;
+    int page_val = Random()%numUsablePhysPages;
     int vpn = vpn_of_physpage[page_val];
 
     while(physpage_shared[page_val] == TRUE)
     {
-        page_val = Random()%NumPhysPages;
+        page_val = Random()%numUsablePhysPages;
         vpn = vpn_of_physpage[page_val];
     }
 
-    ASSERT(page_val >= 0 && page_val < NumPhysPages);
+    ASSERT(page_val >= 0 && page_val < (int)numUsablePhysPages);
     return page_val;
 }  
 
@@ -30,6 +30,9 @@ class ProcessAddressSpace {
 
     ProcessAddressSpace (ProcessAddressSpace *parentSpace);	// Used by fork
 
+    ProcessAddressSpace (FILE *checkpoint);	// Read back from a checkpoint
+    void WriteCheckpoint(FILE *checkpoint);	// Save to a checkpoint
+
     ~ProcessAddressSpace();			// De-allocate an address space
 
     void InitUserModeCPURegisters();		// Initialize user-level CPU registers,
@@ -38,6 +41,13 @@ class ProcessAddressSpace {
     void SaveContextOnSwitch();			// Save/restore address space-specific
     void RestoreContextOnSwitch();		// info on a context switch
 
+    bool RefillTLB(unsigned vaddr);		// Load the translation of vaddr
+					// into the TLB, if the page is
+					// in memory
+    void FlushTLB(int vpn);		// Write the use/dirty bits of TLB
+					// entries back to the page table, and
+					// drop them (all of them if vpn is -1)
+
     unsigned GetNumPages();
 
     TranslationEntry* GetPageTable();
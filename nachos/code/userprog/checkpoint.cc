@@ -0,0 +1,330 @@
+// checkpoint.cc
+//	Routines to save the state of the simulation to a checkpoint file
+//	("-ckpt <file> <time>"), and to carry on from one in a new Nachos
+//	process ("-restore <file>").
+//
+//	The file is written and read back in large blocks (main memory in
+//	one piece, each page table and backing store in one piece), with
+//	no parsing: it is only meant to be read by the same Nachos binary
+//	on the same host.
+//
+//	When restored, every thread gets a fresh kernel stack, starting
+//	in RestartFunction, which finishes the system call the thread was
+//	in (see NachOSThread::FinishTrap), then goes back to user code.
+//	The random number generator and the contents of the TLB are not
+//	saved.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "syscall.h"
+#include "checkpoint.h"
+
+#define CheckpointMagic		0x4e434b50	// "NCKP"
+#define CheckpointVersion	6
+
+// Things that must match between the Nachos that wrote a checkpoint
+// and the one that reads it.
+struct CheckpointHeader {
+    int magic, version;
+    int numPhysPages, pageSize, numTotalRegs, maxThreads, statsSize;
+};
+
+//----------------------------------------------------------------------
+// CheckpointWrite, CheckpointRead
+// 	Write or read "size" bytes at "buffer"; a short read or write
+//	is fatal.
+//----------------------------------------------------------------------
+
+void
+CheckpointWrite(FILE *file, void *buffer, int size)
+{
+    if ((size > 0) && (fwrite(buffer, 1, size, file) != (size_t) size)) {
+	perror("checkpoint");
+	ASSERT(FALSE);
+    }
+}
+
+void
+CheckpointRead(FILE *file, void *buffer, int size)
+{
+    if ((size > 0) && (fread(buffer, 1, size, file) != (size_t) size)) {
+	printf("Checkpoint file is too short\n");
+	ASSERT(FALSE);
+    }
+}
+
+//----------------------------------------------------------------------
+// SetHeader
+// 	Fill in the header describing this Nachos.
+//----------------------------------------------------------------------
+
+static void
+SetHeader(CheckpointHeader *header)
+{
+    header->magic = CheckpointMagic;
+    header->version = CheckpointVersion;
+    header->numPhysPages = NumPhysPages;
+    header->pageSize = PageSize;
+    header->numTotalRegs = NumTotalRegs;
+    header->maxThreads = MAX_THREAD_COUNT;
+    header->statsSize = sizeof(Statistics);
+}
+
+//----------------------------------------------------------------------
+// CanRestart
+// 	Return TRUE if "thread" could be restarted from a checkpoint: it
+//	runs a user program, and is in user code, or in a page fault,
+//	or in a Yield, Sleep or Join system call.
+//----------------------------------------------------------------------
+
+static bool
+CanRestart(NachOSThread *thread)
+{
+    if (thread->space == NULL)
+	return FALSE;
+    switch (thread->GetTrap()) {
+      case NO_TRAP:
+      case FAULT_TRAP:
+      case SysCall_Yield:
+      case SysCall_Sleep:
+      case SysCall_Join:
+	return TRUE;
+      default:
+	return FALSE;
+    }
+}
+
+//----------------------------------------------------------------------
+// TakeCheckpoint
+// 	Write the state of the simulation to checkpointFile.  Called on
+//	return from the timer interrupt handler, once checkpointTime has
+//	come, if the current thread was running user code.
+//
+//	Returns FALSE, without writing anything, if some thread is doing
+//	something in the kernel that can't be restarted, or a device is
+//	busy, or there are several CPUs; the timer tries again later.
+//----------------------------------------------------------------------
+
+bool
+TakeCheckpoint()
+{
+    CheckpointHeader header;
+    NachOSThread *sleepers[MAX_THREAD_COUNT];
+    FILE *file;
+    int when, pid, count, sleeping, owner[NumPhysPages];
+    unsigned wakeups[MAX_THREAD_COUNT];
+
+    if ((checkpointFile == NULL) || (numCPUs > 1)
+		|| !interrupt->NextTimerInterrupt(&when))
+	return FALSE;
+    count = 0;
+    for (pid = 0; pid < (int) thread_index; pid++) {
+	if (exitThreadArray[pid] || (threadArray[pid] == NULL))
+	    continue;
+	if (!CanRestart(threadArray[pid]))
+	    return FALSE;
+	count++;
+    }
+
+    if ((file = fopen(checkpointFile, "w")) == NULL) {
+	perror(checkpointFile);
+	checkpointFile = NULL;		// don't keep trying
+	return FALSE;
+    }
+    SetHeader(&header);
+    CheckpointWrite(file, &header, sizeof(header));
+
+    // Settings and global kernel state
+    CheckpointWrite(file, &schedulingAlgo, sizeof(schedulingAlgo));
+    CheckpointWrite(file, &pageReplaceAlgo, sizeof(pageReplaceAlgo));
+    CheckpointWrite(file, &schedQuantum, sizeof(schedQuantum));
+    CheckpointWrite(file, &adaptiveQuantum, sizeof(adaptiveQuantum));
+    CheckpointWrite(file, &minSchedQuantum, sizeof(minSchedQuantum));
+    CheckpointWrite(file, &maxSchedQuantum, sizeof(maxSchedQuantum));
+    CheckpointWrite(file, &mlfqLevels, sizeof(mlfqLevels));
+    CheckpointWrite(file, mlfqQuantum, sizeof(int) * MAX_MLFQ_LEVELS);
+    CheckpointWrite(file, &mlfqBoostPeriod, sizeof(mlfqBoostPeriod));
+    CheckpointWrite(file, &burstEstimator, sizeof(burstEstimator));
+    CheckpointWrite(file, &numUsablePhysPages, sizeof(numUsablePhysPages));
+    CheckpointWrite(file, &excludeMainThread, sizeof(excludeMainThread));
+    CheckpointWrite(file, &numPagesAllocated, sizeof(numPagesAllocated));
+    CheckpointWrite(file, &thread_index, sizeof(thread_index));
+    CheckpointWrite(file, exitThreadArray, sizeof(bool) * MAX_THREAD_COUNT);
+    CheckpointWrite(file, completionTimeArray, sizeof(int) * MAX_THREAD_COUNT);
+    CheckpointWrite(file, &cpu_burst_start_time, sizeof(cpu_burst_start_time));
+
+    // Who has each physical page
+    for (int i = 0; i < NumPhysPages; i++)
+	owner[i] = (physpage_owner[i] != NULL) ? physpage_owner[i]->GetPID() : -1;
+    CheckpointWrite(file, owner, sizeof(owner));
+    CheckpointWrite(file, vpn_of_physpage, sizeof(int) * NumPhysPages);
+    CheckpointWrite(file, pid_of_physpage, sizeof(int) * NumPhysPages);
+    CheckpointWrite(file, physpage_shared, sizeof(bool) * NumPhysPages);
+    CheckpointWrite(file, physpage_FIFO, sizeof(int) * NumPhysPages);
+    CheckpointWrite(file, physpage_LRU, sizeof(int) * NumPhysPages);
+    CheckpointWrite(file, physpage_LRUclock, sizeof(int) * NumPhysPages);
+    CheckpointWrite(file, &LRUclockPointer, sizeof(LRUclockPointer));
+
+    // The machine
+    CheckpointWrite(file, stats, sizeof(Statistics));
+    CheckpointWrite(file, &when, sizeof(when));
+    CheckpointWrite(file, machine->mainMemory, MemorySize);
+
+    // The threads, and their address spaces
+    pid = currentThread->GetPID();
+    CheckpointWrite(file, &pid, sizeof(pid));
+    CheckpointWrite(file, &count, sizeof(count));
+    currentThread->SaveUserState();	// its registers are in the machine
+    for (pid = 0; pid < (int) thread_index; pid++) {
+	if (exitThreadArray[pid] || (threadArray[pid] == NULL))
+	    continue;
+	threadArray[pid]->WriteCheckpoint(file);
+	threadArray[pid]->space->WriteCheckpoint(file);
+    }
+    currentThread->RestoreUserState();
+
+    // The ready and sleep queues
+    scheduler->WriteCheckpoint(file);
+    sleeping = sleepQueue->Sorted(sleepers, wakeups);
+    for (int i = 0; i < sleeping; i++) {
+	pid = sleepers[i]->GetPID();
+	CheckpointWrite(file, &pid, sizeof(pid));
+	CheckpointWrite(file, &wakeups[i], sizeof(wakeups[i]));
+    }
+    pid = -1;
+    CheckpointWrite(file, &pid, sizeof(pid));
+
+    fclose(file);
+    printf("Checkpoint written to %s at time %d.\n", checkpointFile,
+	stats->totalTicks);
+    checkpointFile = NULL;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// RestartFunction
+// 	Where a thread restored from a checkpoint starts: finish the
+//	system call it was in, if any, and go back to user code.
+//----------------------------------------------------------------------
+
+static void
+RestartFunction(int dummy)
+{
+    currentThread->Startup();
+    currentThread->FinishTrap();
+    machine->Run();
+}
+
+//----------------------------------------------------------------------
+// RestoreCheckpoint
+// 	Carry on from the checkpoint in "fileName": rebuild the threads
+//	and the rest of the state, then switch to the thread that was
+//	running when the checkpoint was taken.  The thread we are called
+//	in (the main thread) goes away.
+//----------------------------------------------------------------------
+
+void
+RestoreCheckpoint(char *fileName)
+{
+    CheckpointHeader header, expected;
+    NachOSThread *bootstrap = currentThread, *thread;
+    NachOSThread **restored = new NachOSThread*[MAX_THREAD_COUNT];
+    Statistics saved;
+    FILE *file;
+    int when, pid, currentPid, count, i, owner[NumPhysPages];
+    unsigned index, wakeup;
+
+    if ((file = fopen(fileName, "r")) == NULL) {
+	printf("Unable to open checkpoint %s\n", fileName);
+	return;
+    }
+    SetHeader(&expected);
+    CheckpointRead(file, &header, sizeof(header));
+    if (memcmp(&header, &expected, sizeof(header)) != 0) {
+	printf("%s is not a checkpoint of this Nachos\n", fileName);
+	fclose(file);
+	return;
+    }
+
+    CheckpointRead(file, &schedulingAlgo, sizeof(schedulingAlgo));
+    CheckpointRead(file, &pageReplaceAlgo, sizeof(pageReplaceAlgo));
+    CheckpointRead(file, &schedQuantum, sizeof(schedQuantum));
+    CheckpointRead(file, &adaptiveQuantum, sizeof(adaptiveQuantum));
+    CheckpointRead(file, &minSchedQuantum, sizeof(minSchedQuantum));
+    CheckpointRead(file, &maxSchedQuantum, sizeof(maxSchedQuantum));
+    CheckpointRead(file, &mlfqLevels, sizeof(mlfqLevels));
+    CheckpointRead(file, mlfqQuantum, sizeof(int) * MAX_MLFQ_LEVELS);
+    CheckpointRead(file, &mlfqBoostPeriod, sizeof(mlfqBoostPeriod));
+    CheckpointRead(file, &burstEstimator, sizeof(burstEstimator));
+    CheckpointRead(file, &numUsablePhysPages, sizeof(numUsablePhysPages));
+    CheckpointRead(file, &excludeMainThread, sizeof(excludeMainThread));
+    CheckpointRead(file, &numPagesAllocated, sizeof(numPagesAllocated));
+    CheckpointRead(file, &index, sizeof(index));
+    CheckpointRead(file, exitThreadArray, sizeof(bool) * MAX_THREAD_COUNT);
+    CheckpointRead(file, completionTimeArray, sizeof(int) * MAX_THREAD_COUNT);
+    CheckpointRead(file, &cpu_burst_start_time, sizeof(cpu_burst_start_time));
+
+    CheckpointRead(file, owner, sizeof(owner));
+    CheckpointRead(file, vpn_of_physpage, sizeof(int) * NumPhysPages);
+    CheckpointRead(file, pid_of_physpage, sizeof(int) * NumPhysPages);
+    CheckpointRead(file, physpage_shared, sizeof(bool) * NumPhysPages);
+    CheckpointRead(file, physpage_FIFO, sizeof(int) * NumPhysPages);
+    CheckpointRead(file, physpage_LRU, sizeof(int) * NumPhysPages);
+    CheckpointRead(file, physpage_LRUclock, sizeof(int) * NumPhysPages);
+    CheckpointRead(file, &LRUclockPointer, sizeof(LRUclockPointer));
+
+    CheckpointRead(file, &saved, sizeof(Statistics));
+    CheckpointRead(file, &when, sizeof(when));
+    CheckpointRead(file, machine->mainMemory, MemorySize);
+
+    // Rebuild the threads.  With no current thread, the constructor
+    // doesn't make them children of the main thread; their real pids
+    // and families come from the checkpoint.
+    CheckpointRead(file, &currentPid, sizeof(currentPid));
+    CheckpointRead(file, &count, sizeof(count));
+    for (i = 0; i < MAX_THREAD_COUNT; i++)
+	restored[i] = NULL;
+    currentThread = NULL;
+    for (i = 0; i < count; i++) {
+	thread = new NachOSThread("restored", MIN_NICE_PRIORITY);
+	thread->ReadCheckpoint(file);
+	thread->space = new ProcessAddressSpace(file);
+	thread->CreateThreadStack(RestartFunction, 0);
+	restored[thread->GetPID()] = thread;
+    }
+    currentThread = bootstrap;
+    for (i = 0; i < MAX_THREAD_COUNT; i++)
+	threadArray[i] = restored[i];
+    thread_index = index;
+    for (i = 0; i < NumPhysPages; i++)
+	physpage_owner[i] = (owner[i] != -1) ? threadArray[owner[i]] : NULL;
+    delete [] restored;
+
+    scheduler->ReadCheckpoint(file);
+    for (;;) {
+	CheckpointRead(file, &pid, sizeof(pid));
+	if (pid == -1)
+	    break;
+	CheckpointRead(file, &wakeup, sizeof(wakeup));
+	sleepQueue->Insert(threadArray[pid], wakeup);
+    }
+    fclose(file);
+
+    *stats = saved;
+    interrupt->MoveTimerInterrupt(when);
+    printf("Restored checkpoint %s at time %d.\n", fileName, stats->totalTicks);
+
+    // Switch to the thread that was running; it deletes us
+    thread = threadArray[currentPid];
+    ASSERT((thread != NULL) && (thread->getStatus() == RUNNING));
+    (void) interrupt->SetLevel(IntOff);
+    threadToBeDestroyed = bootstrap;
+    currentThread = thread;
+    cpuThread[currentCPU] = thread;
+    _SWITCH(bootstrap, thread);
+    ASSERT(FALSE);			// not reached
+}
@@ -0,0 +1,38 @@
+// checkpoint.h
+//	Routines to save the state of the whole simulation to a file, and
+//	to carry on from such a file later, in another Nachos process.
+//
+//	A checkpoint holds main memory, the page tables and backing store
+//	of every address space, the threads (with their user registers),
+//	the ready and sleep queues, the time of the next timer interrupt,
+//	and the statistics.
+//
+//	Kernel stacks can't be saved (they hold host addresses), so a
+//	checkpoint is only taken when every thread could be restarted on
+//	a fresh stack: each one is either in user code, or stopped in a
+//	page fault, or in one of the Yield, Sleep and Join system calls.
+//	Otherwise (or if an I/O device is busy), the checkpoint waits for
+//	a later timer interrupt.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "copyright.h"
+#include "utility.h"
+
+extern bool TakeCheckpoint();		// Write the checkpoint asked for
+					// with -ckpt; FALSE if it has to
+					// wait for a later time
+extern void RestoreCheckpoint(char *fileName);
+					// Carry on from a checkpoint; never
+					// returns
+
+// Used by the classes that save part of the state
+extern void CheckpointWrite(FILE *file, void *buffer, int size);
+extern void CheckpointRead(FILE *file, void *buffer, int size);
+
+#endif // CHECKPOINT_H
@@ -79,11 +79,70 @@ static void ConvertIntToHex (unsigned v, Console *console)
    }
 }
 
+//----------------------------------------------------------------------
+// UserPage
+// 	Translate the virtual address "vaddr" of the current process,
+//	bringing its page into memory (or the TLB) first if need be,
+//	exactly as a load by the program would.
+//	Returns where it is in main memory, and sets "*left" to the number
+//	of bytes from there to the end of the page.
+//
+//	Returns NULL if the address is bad, for the system call to fail
+//	(rather than raising an exception the kernel would die of).
+//----------------------------------------------------------------------
+
+static char *
+UserPage(int vaddr, int *left)
+{
+   ExceptionType exception;
+   MachineStatus status;
+   int physAddr;
+
+   while ((exception = machine->Translate(vaddr, &physAddr, 1, FALSE)) != NoException) {
+      if (exception != PageFaultException) return NULL;
+      status = interrupt->getStatus();
+      machine->RaiseException(exception, vaddr);   // fault the page in
+      interrupt->setStatus(status);
+   }
+   physpage_LRU[physAddr/PageSize] = stats->totalTicks;
+   physpage_LRUclock[physAddr/PageSize] = 1;
+   *left = PageSize - (physAddr % PageSize);
+   return &machine->mainMemory[physAddr];
+}
+
+//----------------------------------------------------------------------
+// CopyStringFromUser
+// 	Copy the null-terminated string at "vaddr" in the current process's
+//	virtual memory into "buffer", a page at a time.  At most size-1
+//	characters are copied, and the copy is always null-terminated.
+//	Returns the number of characters copied (size-1 if the string
+//	was cut short), or -1 if some address is bad.
+//----------------------------------------------------------------------
+
+int
+CopyStringFromUser(int vaddr, char *buffer, int size)
+{
+   char *from, *end;
+   int left, length = 0;
+
+   while (length < size - 1) {
+      if ((from = UserPage(vaddr + length, &left)) == NULL) return -1;
+      if (left > size - 1 - length) left = size - 1 - length;
+      end = (char *) memchr(from, '\0', left);
+      if (end != NULL) left = end - from;
+      memcpy(buffer + length, from, left);
+      length += left;
+      if (end != NULL) break;
+   }
+   buffer[length] = '\0';
+   return length;
+}
+
 void
 ExceptionHandler(ExceptionType which)
 {
     int type = machine->ReadRegister(2);
-    int memval, vaddr, printval, tempval, exp;
+    int vaddr, printval, tempval, exp, length;
     unsigned printvalus;	// Used for printing in hex
     if (!initializedConsoleSemaphores) {
        readAvail = new Semaphore("read avail", 0);
@@ -93,15 +152,26 @@ ExceptionHandler(ExceptionType which)
     Console *console = new Console(NULL, NULL, ReadAvail, WriteDone, 0);
     int exitcode;		// Used in SysCall_Exit
     unsigned i;
-    char buffer[1024];		// Used in SysCall_Exec
+    char buffer[1024];		// Used in SysCall_Exec and SysCall_PrintString
     int waitpid;		// Used in SysCall_Join
     int whichChild;		// Used in SysCall_Join
     NachOSThread *child;		// Used by SysCall_Fork
     unsigned sleeptime;		// Used by SysCall_Sleep
+    bool outermostTrap = (currentThread->GetTrap() == NO_TRAP);
+
+    // Note what we are doing for the thread, in case a checkpoint is
+    // taken while it is stopped in the kernel (see checkpoint.h)
+    if (outermostTrap)
+       currentThread->SetTrap((which == SyscallException) ? type : FAULT_TRAP);
 
     
 
-     if(which == PageFaultException){
+     if((which == PageFaultException) && (machine->tlb != NULL)
+        && currentThread->space->RefillTLB(machine->registers[BadVAddrReg])){
+        // Only a TLB miss: the page is in memory, and is now in the TLB.
+    }
+
+     else if(which == PageFaultException){
 
         printf("page fault\n");
          IntStatus old_Level = interrupt->SetLevel(IntOff);
@@ -135,6 +205,12 @@ ExceptionHandler(ExceptionType which)
        // We do not wait for the children to finish.
        // The children will continue to run.
        // We will worry about this when and if we implement signals.
+       if (profiler != NULL)
+          profiler->Finish(currentThread->GetPID());
+       if (machine->icache != NULL)
+          machine->icache->Report(currentThread->GetPID());
+       if (machine->dcache != NULL)
+          machine->dcache->Report(currentThread->GetPID());
        currentThread->space->cleanPages();
        exitThreadArray[currentThread->GetPID()] = true;
 
@@ -147,16 +223,17 @@ ExceptionHandler(ExceptionType which)
     else if ((which == SyscallException) && (type == SysCall_Exec)) {
        // Copy the executable name into kernel space
        vaddr = machine->ReadRegister(4);
-       machine->ReadMem(vaddr, 1, &memval);
-       i = 0;
-       while ((*(char*)&memval) != '\0') {
-          buffer[i] = (*(char*)&memval);
-          i++;
-          vaddr++;
-          while(!machine->ReadMem(vaddr, 1, &memval));    //it keeps going in a loop till ReadMem successfully reads
+       length = CopyStringFromUser(vaddr, buffer, sizeof(buffer));
+       if ((length >= 0) && (length < (int) sizeof(buffer) - 1))
+          LaunchUserProcess(buffer);
+       else {		// a bad address, or a name too long
+          printf("[pid %d] Exec: bad file name.\n", currentThread->GetPID());
+          machine->WriteRegister(2, -1);
+          // Advance program counters.
+          machine->WriteRegister(PrevPCReg, machine->ReadRegister(PCReg));
+          machine->WriteRegister(PCReg, machine->ReadRegister(NextPCReg));
+          machine->WriteRegister(NextPCReg, machine->ReadRegister(NextPCReg)+4);
        }
-       buffer[i] = (*(char*)&memval);
-       LaunchUserProcess(buffer);
     }
     else if ((which == SyscallException) && (type == SysCall_Join)) {
        waitpid = machine->ReadRegister(4);
@@ -242,13 +319,14 @@ ExceptionHandler(ExceptionType which)
     }
     else if ((which == SyscallException) && (type == SysCall_PrintString)) {
        vaddr = machine->ReadRegister(4);
-       machine->ReadMem(vaddr, 1, &memval);
-       while ((*(char*)&memval) != '\0') {
-          writeDone->P() ;
-          console->PutChar(*(char*)&memval);
-          vaddr++;
-          machine->ReadMem(vaddr, 1, &memval);
-       }
+       do {		// a buffer at a time
+          length = CopyStringFromUser(vaddr, buffer, sizeof(buffer));
+          for (i = 0; (int) i < length; i++) {
+             writeDone->P() ;
+             console->PutChar(buffer[i]);
+          }
+          vaddr += length;
+       } while (length == sizeof(buffer) - 1);
        // Advance program counters.
        machine->WriteRegister(PrevPCReg, machine->ReadRegister(PCReg));
        machine->WriteRegister(PCReg, machine->ReadRegister(NextPCReg));
@@ -322,6 +400,16 @@ ExceptionHandler(ExceptionType which)
        machine->WriteRegister(PCReg, machine->ReadRegister(NextPCReg));
        machine->WriteRegister(NextPCReg, machine->ReadRegister(NextPCReg)+4);
     }
+    else if ((which == SyscallException) && (type == SysCall_SetRealTime)) {
+       IntStatus oldLevel = interrupt->SetLevel(IntOff);
+       machine->WriteRegister(2, scheduler->SetRealTime(currentThread, 
+		machine->ReadRegister(4), machine->ReadRegister(5)));
+       (void) interrupt->SetLevel(oldLevel);
+       // Advance program counters.
+       machine->WriteRegister(PrevPCReg, machine->ReadRegister(PCReg));
+       machine->WriteRegister(PCReg, machine->ReadRegister(NextPCReg));
+       machine->WriteRegister(NextPCReg, machine->ReadRegister(NextPCReg)+4);
+    }
     else if ((which == SyscallException) && (type == SysCall_NumInstr)) {
        machine->WriteRegister(2, currentThread->GetInstructionCount());
        // Advance program counters.
@@ -332,4 +420,6 @@ ExceptionHandler(ExceptionType which)
 	printf("Unexpected user mode exception %d %d\n", which, type);
 	ASSERT(FALSE);
     }
+    if (outermostTrap)
+       currentThread->SetTrap(NO_TRAP);
 }
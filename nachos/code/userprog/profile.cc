@@ -0,0 +1,409 @@
+// profile.cc
+//	Routines to profile user programs.
+//
+//	Machine::OneInstruction (and the direct-threaded Machine::Run)
+//	count each instruction they fetch; if it then traps (a page fault,
+//	say), RaiseException takes the count back, since the instruction
+//	will be executed again.  Loads and stores are counted by ReadMem
+//	and WriteMem, once the address has been translated.  Basic block
+//	mode is turned off while profiling.
+//
+//	A new basic block starts at the target of each branch or jump,
+//	after the delay slot of a branch that was not taken, and after a
+//	system call.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "profile.h"
+#include "mipssim.h"
+#include "system.h"
+
+#define MaxSymbols	4096
+
+//----------------------------------------------------------------------
+// ProcessProfile::ProcessProfile
+// 	Start an empty profile of the program running in "space", as
+//	process "pid".
+//----------------------------------------------------------------------
+
+ProcessProfile::ProcessProfile(int id, ProcessAddressSpace *addrSpace)
+{
+    char *name;
+
+    pid = id;
+    space = addrSpace;
+    name = (space->execFile != NULL) ? space->execFile : (char *) "?";
+    program = new char[strlen(name) + 1];
+    strcpy(program, name);
+    numPages = numWords = 0;
+    pcCounts = blockCounts = loads = stores = NULL;
+    opCounts = new unsigned[MaxOpcode + 1];
+    bzero(opCounts, (MaxOpcode + 1) * sizeof(unsigned));
+    numInstructions = 0;
+    lastPC = nextLeader = -1;
+    lastOp = 0;
+    lastWasLeader = FALSE;
+    savedLastPC = savedNextLeader = -1;
+    Grow(space->GetNumPages());
+}
+
+ProcessProfile::~ProcessProfile()
+{
+    delete [] program;
+    delete [] pcCounts;
+    delete [] blockCounts;
+    delete [] opCounts;
+    delete [] loads;
+    delete [] stores;
+}
+
+//----------------------------------------------------------------------
+// ProcessProfile::Grow
+// 	Make room for an address space of "pages" pages (shared memory
+//	is added at the end of the address space), keeping the counts
+//	so far.
+//----------------------------------------------------------------------
+
+static unsigned *
+GrowCounts(unsigned *counts, int oldSize, int newSize)
+{
+    unsigned *newCounts = new unsigned[newSize];
+
+    bzero(newCounts, newSize * sizeof(unsigned));
+    if (counts != NULL) {
+	bcopy(counts, newCounts, oldSize * sizeof(unsigned));
+	delete [] counts;
+    }
+    return newCounts;
+}
+
+void
+ProcessProfile::Grow(int pages)
+{
+    int words = pages * PageSize / 4;
+
+    if (pages <= numPages)
+	return;
+    pcCounts = GrowCounts(pcCounts, numWords, words);
+    blockCounts = GrowCounts(blockCounts, numWords, words);
+    loads = GrowCounts(loads, numPages, pages);
+    stores = GrowCounts(stores, numPages, pages);
+    numWords = words;
+    numPages = pages;
+}
+
+//----------------------------------------------------------------------
+// UserProfiler::UserProfiler
+// 	Initialize the profiler; profiles are written to "fileName".
+//----------------------------------------------------------------------
+
+UserProfiler::UserProfiler(char *fileName)
+{
+    out = fopen(fileName, "w");
+    if (out == NULL) {
+	perror(fileName);
+	out = stdout;
+    }
+    profiles = new ProcessProfile*[MAX_THREAD_COUNT];
+    for (int i = 0; i < MAX_THREAD_COUNT; i++)
+	profiles[i] = NULL;
+    last = NULL;
+    symbolsOf[0] = '\0';
+    numSymbols = 0;
+    symbolAddrs = new int[MaxSymbols];
+    symbolNames = new char*[MaxSymbols];
+}
+
+//----------------------------------------------------------------------
+// UserProfiler::~UserProfiler
+// 	Write out the profiles of the processes still around.
+//----------------------------------------------------------------------
+
+UserProfiler::~UserProfiler()
+{
+    for (int i = 0; i < MAX_THREAD_COUNT; i++)
+	if (profiles[i] != NULL)
+	    Finish(i);
+    if (out != stdout)
+	fclose(out);
+    for (int i = 0; i < numSymbols; i++)
+	delete [] symbolNames[i];
+    delete [] profiles;
+    delete [] symbolAddrs;
+    delete [] symbolNames;
+}
+
+//----------------------------------------------------------------------
+// UserProfiler::Current
+// 	Return the profile of the current process, starting a new one if
+//	it has none yet, or has since exec'ed another program.
+//----------------------------------------------------------------------
+
+ProcessProfile *
+UserProfiler::Current()
+{
+    int pid = currentThread->GetPID();
+    ProcessProfile *profile = profiles[pid];
+
+    if ((profile != NULL) && (profile->space != currentThread->space)) {
+	Finish(pid);
+	profile = NULL;
+    }
+    if (profile == NULL)
+	profile = profiles[pid] = new ProcessProfile(pid, currentThread->space);
+    else
+	profile->Grow(currentThread->space->GetNumPages());
+    return profile;
+}
+
+//----------------------------------------------------------------------
+// UserProfiler::CountInstruction
+// 	Count the instruction "instr", at "pc", of the current process.
+//----------------------------------------------------------------------
+
+void
+UserProfiler::CountInstruction(int pc, Instruction *instr)
+{
+    ProcessProfile *profile = Current();
+    int word = pc >> 2;
+
+    if ((word < 0) || (word >= profile->numWords))
+	return;				// it's about to trap anyway
+    profile->savedLastPC = profile->lastPC;
+    profile->savedNextLeader = profile->nextLeader;
+    profile->lastWasLeader = (pc != profile->lastPC + 4)
+				|| (pc == profile->nextLeader);
+    if (profile->lastWasLeader)
+	profile->blockCounts[word]++;
+    profile->pcCounts[word]++;
+    profile->opCounts[(int) instr->opCode]++;
+    profile->numInstructions++;
+    profile->lastOp = instr->opCode;
+    profile->lastPC = pc;
+    if (EndsBlock(instr))
+	profile->nextLeader = pc + 8;	// after the delay slot
+    else if (instr->opCode == OP_SYSCALL)
+	profile->nextLeader = pc + 4;
+    last = profile;
+}
+
+//----------------------------------------------------------------------
+// UserProfiler::Retract
+// 	Take back the count of the last instruction, which trapped, if
+//	it was the one at "pc" (if the trap was in fetching the next 
+//	instruction, that one was never counted).
+//----------------------------------------------------------------------
+
+void
+UserProfiler::Retract(int pc)
+{
+    ProcessProfile *profile = last;
+    int word;
+
+    if ((profile == NULL) || (profile->lastPC != pc))
+	return;
+    word = profile->lastPC >> 2;
+    if (profile->lastWasLeader)
+	profile->blockCounts[word]--;
+    profile->pcCounts[word]--;
+    profile->opCounts[profile->lastOp]--;
+    profile->numInstructions--;
+    profile->lastPC = profile->savedLastPC;
+    profile->nextLeader = profile->savedNextLeader;
+    last = NULL;
+}
+
+//----------------------------------------------------------------------
+// UserProfiler::CountAccess
+// 	Count a load from (or store to, if "writing") virtual address
+//	"addr" by the current process.
+//----------------------------------------------------------------------
+
+void
+UserProfiler::CountAccess(int addr, bool writing)
+{
+    ProcessProfile *profile = Current();
+    int page = (unsigned) addr / PageSize;
+
+    if (page >= profile->numPages)
+	return;
+    if (writing)
+	profile->stores[page]++;
+    else
+	profile->loads[page]++;
+}
+
+//----------------------------------------------------------------------
+// UserProfiler::Finish
+// 	Write out and delete the profile of process "pid", if it has one.
+//----------------------------------------------------------------------
+
+void
+UserProfiler::Finish(int pid)
+{
+    ProcessProfile *profile = profiles[pid];
+
+    if (profile == NULL)
+	return;
+    Dump(profile);
+    if (last == profile)
+	last = NULL;
+    profiles[pid] = NULL;
+    delete profile;
+}
+
+//----------------------------------------------------------------------
+// UserProfiler::ReadSymbols
+// 	Load the symbols of "program", from the file coff2noff wrote
+//	next to it: one "<hex address> <name>" line per function.
+//	If there is no such file, addresses are printed bare.
+//----------------------------------------------------------------------
+
+void
+UserProfiler::ReadSymbols(char *program)
+{
+    char fileName[256], name[256];
+    unsigned addr;
+    FILE *in;
+    int i;
+
+    if (!strcmp(symbolsOf, program))
+	return;				// already have them
+    for (i = 0; i < numSymbols; i++)
+	delete [] symbolNames[i];
+    numSymbols = 0;
+    sprintf(symbolsOf, "%.*s", (int) sizeof(symbolsOf) - 1, program);
+
+    sprintf(fileName, "%.250s.sym", program);
+    if ((in = fopen(fileName, "r")) == NULL)
+	return;
+    while ((numSymbols < MaxSymbols)
+		&& (fscanf(in, "%x %255s", &addr, name) == 2)) {
+	// insertion sort, by address
+	for (i = numSymbols; (i > 0) && (symbolAddrs[i - 1] > (int) addr); i--) {
+	    symbolAddrs[i] = symbolAddrs[i - 1];
+	    symbolNames[i] = symbolNames[i - 1];
+	}
+	symbolAddrs[i] = addr;
+	symbolNames[i] = new char[strlen(name) + 1];
+	strcpy(symbolNames[i], name);
+	numSymbols++;
+    }
+    fclose(in);
+}
+
+//----------------------------------------------------------------------
+// UserProfiler::PrintAddress
+// 	Print "addr" as function+offset, if we know the function.
+//----------------------------------------------------------------------
+
+void
+UserProfiler::PrintAddress(int addr)
+{
+    int low = 0, high = numSymbols - 1, mid;
+
+    // find the last symbol at or before addr
+    while (low <= high) {
+	mid = (low + high) / 2;
+	if (symbolAddrs[mid] <= addr)
+	    low = mid + 1;
+	else
+	    high = mid - 1;
+    }
+    if (high < 0)
+	fprintf(out, "0x%x", addr);
+    else
+	fprintf(out, "%s+0x%x", symbolNames[high], addr - symbolAddrs[high]);
+}
+
+//----------------------------------------------------------------------
+// UserProfiler::Dump
+// 	Write out a profile: the opcode mix, the instructions executed
+//	and the time spent in each function, each basic block and each
+//	instruction, and the loads and stores to each page.
+//----------------------------------------------------------------------
+
+void
+UserProfiler::Dump(ProcessProfile *profile)
+{
+    unsigned total = profile->numInstructions;
+    unsigned count, *byFunction;
+    int i, j, k, *order, numBlocks;
+
+    if (total == 0)
+	total = 1;			// avoid dividing by zero
+    ReadSymbols(profile->program);
+
+    fprintf(out, "Profile of pid %d (%s): %u instructions\n", profile->pid,
+	profile->program, profile->numInstructions);
+
+    fprintf(out, "\nOpcode mix:\n");
+    for (i = 0; i <= MaxOpcode; i++) {
+	if (profile->opCounts[i] == 0)
+	    continue;
+	for (j = 0; (opStrings[i].string[j] != ' ')
+			&& (opStrings[i].string[j] != '\0'); j++)
+	    ;
+	fprintf(out, "  %-8.*s %10u %6.2f%%\n", j, opStrings[i].string,
+	    profile->opCounts[i], 100.0 * profile->opCounts[i] / total);
+    }
+
+    if (numSymbols > 0) {
+	byFunction = new unsigned[numSymbols];
+	bzero(byFunction, numSymbols * sizeof(unsigned));
+	for (i = 0, k = 0; i < profile->numWords; i++) {
+	    while ((k + 1 < numSymbols) && (symbolAddrs[k + 1] <= (i << 2)))
+		k++;
+	    if (symbolAddrs[k] <= (i << 2))
+		byFunction[k] += profile->pcCounts[i];
+	}
+	fprintf(out, "\nInstructions by function:\n");
+	for (k = 0; k < numSymbols; k++)
+	    if (byFunction[k] != 0)
+		fprintf(out, "  %-24s %10u %6.2f%%\n", symbolNames[k],
+		    byFunction[k], 100.0 * byFunction[k] / total);
+	delete [] byFunction;
+    }
+
+    // blocks, hottest first (each block counts its instructions)
+    order = new int[profile->numWords];
+    numBlocks = 0;
+    for (i = 0; i < profile->numWords; i++)
+	if (profile->blockCounts[i] != 0)
+	    order[numBlocks++] = i;
+    for (i = 1; i < numBlocks; i++) {	// insertion sort, by count
+	k = order[i];
+	for (j = i; (j > 0) && (profile->blockCounts[order[j - 1]]
+					< profile->blockCounts[k]); j--)
+	    order[j] = order[j - 1];
+	order[j] = k;
+    }
+    fprintf(out, "\nBasic blocks (entries, address):\n");
+    for (i = 0; i < numBlocks; i++) {
+	fprintf(out, "  %10u  0x%06x  ", profile->blockCounts[order[i]],
+	    order[i] << 2);
+	PrintAddress(order[i] << 2);
+	fprintf(out, "\n");
+    }
+    delete [] order;
+
+    fprintf(out, "\nInstructions (count, address):\n");
+    for (i = 0; i < profile->numWords; i++) {
+	if ((count = profile->pcCounts[i]) == 0)
+	    continue;
+	fprintf(out, "  %10u  0x%06x  ", count, i << 2);
+	PrintAddress(i << 2);
+	fprintf(out, "\n");
+    }
+
+    fprintf(out, "\nMemory accesses (page, loads, stores):\n");
+    for (i = 0; i < profile->numPages; i++)
+	if ((profile->loads[i] != 0) || (profile->stores[i] != 0))
+	    fprintf(out, "  %6d %10u %10u\n", i, profile->loads[i],
+		profile->stores[i]);
+    fprintf(out, "\n");
+    fflush(out);
+}
@@ -0,0 +1,90 @@
+// profile.h
+//	Data structures for profiling user programs: how many times each
+//	user instruction and basic block was executed, the mix of opcodes,
+//	and the loads and stores to each page, kept separately for each
+//	process.
+//
+//	The profile of a process is written out when it exits (or execs
+//	another program), and those of the processes still around when
+//	Nachos halts.  Addresses are printed as function+offset, using
+//	the symbols that coff2noff leaves next to the program, in
+//	"<program>.sym".
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "copyright.h"
+#include "utility.h"
+#include "machine.h"
+
+class ProcessAddressSpace;
+
+// The profile of one program, as run by one process
+class ProcessProfile {
+  public:
+    ProcessProfile(int pid, ProcessAddressSpace *space);
+    ~ProcessProfile();
+
+    void Grow(int pages);		// The address space grew
+
+    int pid;				// the process
+    ProcessAddressSpace *space;		// its address space, when it
+					// was profiled
+    char *program;			// what it was running (a copy)
+    int numWords;			// the size of the address space
+    int numPages;			//	(in words and pages)
+
+    unsigned *pcCounts;			// executions of each instruction
+    unsigned *blockCounts;		// entries into the block starting
+					// at each instruction
+    unsigned *opCounts;			// executions of each opcode
+    unsigned *loads, *stores;		// accesses to each page
+    unsigned numInstructions;
+
+    int lastPC;				// the last instruction counted
+    int nextLeader;			// the instruction after the delay
+					// slot of the last branch
+    int lastOp;				// to take back the last count
+    bool lastWasLeader;
+    int savedLastPC, savedNextLeader;
+};
+
+// The profiler itself
+class UserProfiler {
+  public:
+    UserProfiler(char *fileName);	// Profiles go to "fileName"
+    ~UserProfiler();			// Write out what is left
+
+    void CountInstruction(int pc, Instruction *instr);
+					// Count an instruction of the
+					// current process
+    void Retract(int pc);		// Take back the count of the
+					// instruction at pc: it trapped, 
+					// and will be executed again
+    void CountAccess(int addr, bool writing);
+					// Count a load or store
+
+    void Finish(int pid);		// Write out and forget this
+					// process's profile
+
+  private:
+    ProcessProfile *Current();		// The current process's profile
+    void Dump(ProcessProfile *profile);	// Write out a profile
+    void PrintAddress(int addr);	// Print addr as function+offset
+    void ReadSymbols(char *program);	// Load "<program>.sym"
+
+    FILE *out;
+    ProcessProfile **profiles;		// by pid
+    ProcessProfile *last;		// the one counted last (to take back)
+
+    char symbolsOf[256];		// the program the symbols are for
+    int numSymbols;
+    int *symbolAddrs;			// sorted by address
+    char **symbolNames;
+};
+
+#endif // PROFILE_H
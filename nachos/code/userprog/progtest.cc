@@ -38,8 +38,10 @@ LaunchUserProcess(char *filename)
 	printf("Unable to open file %s\n", filename);
 	return;
     }
-    if(pageReplaceAlgo == 0)
+    if(pageReplaceAlgo == 0) {
         space = new ProcessAddressSpace(executable);    
+        space->execFile = filename;     // for the profiler
+    }
     else
         space = new ProcessAddressSpace(filename);
 
@@ -52,6 +54,7 @@ LaunchUserProcess(char *filename)
 
     space->InitUserModeCPURegisters();		// set the initial register values
     space->RestoreContextOnSwitch();		// load page table register
+    currentThread->SetTrap(NO_TRAP);		// in case we came from Exec
 
     machine->Run();			// jump to the user progam
     ASSERT(FALSE);			// machine->Run never returns;
@@ -130,7 +133,7 @@ ReadInputAndFork (char *filename)
    //printf("%d\n", schedulingAlgo);
 
    if ((schedulingAlgo == ROUND_ROBIN) || (schedulingAlgo == UNIX_SCHED)) {
-      ASSERT (SCHED_QUANTUM > 0);
+      ASSERT (schedQuantum > 0);
    }
 
    bytesRead = inFile->Read(&c, 1);
@@ -169,6 +172,7 @@ ReadInputAndFork (char *filename)
       sprintf(buffer,"Thread_%d",i+1);
       NachOSThread *child = new NachOSThread(buffer, priority[i]);
       child->space = new ProcessAddressSpace (inFile);
+      child->space->execFile = batchProcesses[i];
       delete inFile;
       child->space->InitUserModeCPURegisters();             // set the initial register values
       child->SaveUserState ();
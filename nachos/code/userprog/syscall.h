@@ -49,6 +49,7 @@
 #define SysCall_CondOp		25
 #define SysCall_CondRemove	26
 #define SysCall_ShmAllocate	27
+#define SysCall_SetRealTime	28
 #define SysCall_NumInstr        50
 
 #ifndef IN_ASM
@@ -180,6 +181,14 @@ int syscall_wrapper_CondRemove (int condid);
 
 unsigned syscall_wrapper_ShmAllocate (unsigned size);
 
+/* Make the calling thread a real-time thread, which runs for up to
+ * "budget" ticks in every "period" ticks, and is run ahead of the other
+ * threads, earliest deadline (the end of its period) first.  Returns 0,
+ * or -1 if the real-time threads can't all be given their budgets.  A
+ * period of 0 makes it an ordinary thread again.
+ */
+int syscall_wrapper_SetRealTime (unsigned period, unsigned budget);
+
 int syscall_wrapper_GetNumInstr (void);
 #endif /* IN_ASM */
 